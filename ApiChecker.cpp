@@ -16,100 +16,352 @@
 
 #include "ApiChecker.h"
 
+#include <algorithm>
+#include <initializer_list>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "Common.h"
+#include "Parallel.h"
 
 using android::base::Result;
+using sysprop::api_check::ApiCheckReport;
+using sysprop::api_check::Incompatibility;
 
 namespace {
 
-Result<void> CompareProps(const sysprop::Properties& latest,
-                          const sysprop::Properties& current) {
-  std::unordered_map<std::string, sysprop::Property> props;
+// Messages of one kind sorted by name, pointing into the parsed API. Dumps
+// are already sorted, so building an index is usually a single pass, and
+// reusing one keeps its storage across modules. Like a map filled in order,
+// the last of several messages with the same name is the one found.
+template <typename Message, const std::string& (Message::*name)() const>
+class NameIndex {
+ public:
+  template <typename Messages>
+  void Build(const Messages& messages) {
+    index_.clear();
+    index_.reserve(messages.size());
+    for (const Message& message : messages) index_.push_back(&message);
 
-  for (int i = 0; i < current.prop_size(); ++i) {
-    const auto& prop = current.prop(i);
-    props[prop.api_name()] = prop;
+    auto less = [](const Message* a, const Message* b) {
+      return (a->*name)() < (b->*name)();
+    };
+    if (!std::is_sorted(index_.begin(), index_.end(), less)) {
+      std::stable_sort(index_.begin(), index_.end(), less);
+    }
   }
 
-  std::string err;
+  // Returns nullptr if there is no message named |key|.
+  const Message* Find(std::string_view key) const {
+    auto itr = std::upper_bound(
+        index_.begin(), index_.end(), key,
+        [](std::string_view key, const Message* a) {
+          return key < std::string_view((a->*name)());
+        });
+    if (itr == index_.begin() || (*(itr - 1)->*name)() != key) return nullptr;
+    return *(itr - 1);
+  }
 
+ private:
+  std::vector<const Message*> index_;
+};
+
+using PropIndex = NameIndex<sysprop::Property, &sysprop::Property::api_name>;
+using ModuleIndex = NameIndex<sysprop::Properties, &sysprop::Properties::module>;
+
+// Adds an incompatibility to |report|, whose message is the concatenation of
+// |parts|.
+void AddIncompatibility(ApiCheckReport* report, const std::string& module,
+                        const std::string& api_name, Incompatibility::Kind kind,
+                        std::initializer_list<std::string_view> parts) {
+  Incompatibility* incompatibility = report->add_incompatibility();
+  incompatibility->set_module(module);
+  incompatibility->set_api_name(api_name);
+  incompatibility->set_kind(kind);
+  std::string* message = incompatibility->mutable_message();
+  for (std::string_view part : parts) message->append(part);
+}
+
+// Adds the incompatibilities between |latest| and |current| to |report|.
+// |props| is scratch space, reused across modules.
+void CompareProps(const sysprop::Properties& latest,
+                  const sysprop::Properties& current, PropIndex* props,
+                  ApiCheckReport* report) {
+  props->Build(current.prop());
+
+  const std::string& module = latest.module();
   bool latest_empty = true;
-  for (int i = 0; i < latest.prop_size(); ++i) {
-    const auto& latest_prop = latest.prop(i);
+  for (const sysprop::Property& latest_prop : latest.prop()) {
     if (latest_prop.deprecated() || latest_prop.scope() == sysprop::Internal) {
       continue;
     }
 
     latest_empty = false;
 
-    auto itr = props.find(latest_prop.api_name());
-    if (itr == props.end()) {
-      err += "Prop " + latest_prop.api_name() + " has been removed\n";
+    const std::string& api_name = latest_prop.api_name();
+    const sysprop::Property* found = props->Find(api_name);
+    if (found == nullptr) {
+      AddIncompatibility(report, module, api_name, Incompatibility::PropRemoved,
+                         {"Prop ", api_name, " has been removed"});
       continue;
     }
 
-    const auto& current_prop = itr->second;
+    const auto& current_prop = *found;
 
     if (latest_prop.type() != current_prop.type()) {
-      err += "Type of prop " + latest_prop.api_name() + " has been changed\n";
+      AddIncompatibility(report, module, api_name, Incompatibility::TypeChanged,
+                         {"Type of prop ", api_name, " has been changed"});
     }
     // Readonly > Writeonce > ReadWrite
     if (latest_prop.access() > current_prop.access()) {
-      err += "Accessibility of prop " + latest_prop.api_name() +
-             " has become more restrictive\n";
+      AddIncompatibility(report, module, api_name,
+                         Incompatibility::AccessMoreRestrictive,
+                         {"Accessibility of prop ", api_name,
+                          " has become more restrictive"});
     }
     // Public < Internal
     if (latest_prop.scope() < current_prop.scope()) {
-      err += "Scope of prop " + latest_prop.api_name() +
-             " has become more restrictive\n";
+      AddIncompatibility(
+          report, module, api_name, Incompatibility::ScopeMoreRestrictive,
+          {"Scope of prop ", api_name, " has become more restrictive"});
     }
     if (latest_prop.prop_name() != current_prop.prop_name()) {
-      err += "Underlying property of prop " + latest_prop.api_name() +
-             " has been changed\n";
+      AddIncompatibility(
+          report, module, api_name, Incompatibility::PropNameChanged,
+          {"Underlying property of prop ", api_name, " has been changed"});
     }
     if (latest_prop.enum_values() != current_prop.enum_values()) {
-      err += "Enum values of prop " + latest_prop.api_name() +
-             " has been changed\n";
+      AddIncompatibility(
+          report, module, api_name, Incompatibility::EnumValuesChanged,
+          {"Enum values of prop ", api_name, " has been changed"});
     }
     if (latest_prop.integer_as_bool() != current_prop.integer_as_bool()) {
-      err += "Integer-as-bool of prop " + latest_prop.api_name() +
-             " has been changed\n";
+      AddIncompatibility(
+          report, module, api_name, Incompatibility::IntegerAsBoolChanged,
+          {"Integer-as-bool of prop ", api_name, " has been changed"});
     }
   }
 
   if (!latest_empty) {
     if (latest.owner() != current.owner()) {
-      err += "owner of module " + latest.module() + " has been changed\n";
+      AddIncompatibility(report, module, "", Incompatibility::OwnerChanged,
+                         {"owner of module ", module, " has been changed"});
+    }
+  }
+}
+
+// Merges |reports| into one, sorted as described in api_check.proto, and
+// returns the error listing its incompatibilities, if any. The merged report
+// is moved to |report| if non-null.
+Result<void> FinishReport(std::vector<ApiCheckReport>* reports,
+                          ApiCheckReport* report) {
+  ApiCheckReport merged;
+  for (ApiCheckReport& chunk : *reports) {
+    for (Incompatibility& incompatibility :
+         *chunk.mutable_incompatibility()) {
+      *merged.add_incompatibility() = std::move(incompatibility);
     }
   }
 
-  if (err.empty())
-    return {};
-  else
-    return Errorf("{}", err);
+  // Incompatibilities of one prop keep the order in which they were found.
+  auto* incompatibilities = merged.mutable_incompatibility();
+  std::stable_sort(
+      incompatibilities->pointer_begin(), incompatibilities->pointer_end(),
+      [](const Incompatibility* a, const Incompatibility* b) {
+        return std::forward_as_tuple(a->module(), a->api_name().empty(),
+                                     a->api_name()) <
+               std::forward_as_tuple(b->module(), b->api_name().empty(),
+                                     b->api_name());
+      });
+
+  std::string err;
+  for (const Incompatibility& incompatibility : *incompatibilities) {
+    err += incompatibility.module();
+    err += ": ";
+    err += incompatibility.message();
+    err += '\n';
+  }
+
+  if (report != nullptr) *report = std::move(merged);
+  if (!err.empty()) return Errorf("{}", err);
+  return {};
+}
+
+// Returns whether |module| has the same fingerprint in |latest| and
+// |current|, which may be null if fingerprints aren't available.
+bool ModuleFingerprintsMatch(const ApiFingerprints* latest,
+                             const ApiFingerprints* current,
+                             const std::string& module) {
+  if (latest == nullptr || current == nullptr) return false;
+
+  auto latest_itr = latest->find(module);
+  if (latest_itr == latest->end()) return false;
+  auto current_itr = current->find(module);
+  return current_itr != current->end() &&
+         current_itr->second == latest_itr->second;
+}
+
+// Reads the next module of |reader| into |props|, which must sort after
+// |previous| so that both files can be walked in lockstep. Returns false at
+// the end of the file.
+Result<bool> NextSortedModule(ApiFileReader* reader, const std::string& path,
+                              std::string* previous,
+                              sysprop::Properties* props) {
+  auto res = reader->Next(props);
+  if (!res.ok() || !*res) return res;
+
+  if (!previous->empty() && props->module() <= *previous) {
+    return Errorf(
+        "Error parsing {}: module {} comes after {}; modules must be sorted "
+        "as written by sysprop_api_dump",
+        path, props->module(), *previous);
+  }
+  *previous = props->module();
+  return true;
 }
 
 }  // namespace
 
-Result<void> CompareApis(const sysprop::SyspropLibraryApis& latest,
-                         const sysprop::SyspropLibraryApis& current) {
-  std::unordered_map<std::string, sysprop::Properties> propsMap;
+bool FingerprintsMatch(const ApiFingerprints& latest,
+                       const ApiFingerprints& current) {
+  for (const auto& [module, fingerprint] : latest) {
+    auto itr = current.find(module);
+    if (itr == current.end() || itr->second != fingerprint) return false;
+  }
+  return true;
+}
+
+Result<void> CompareApiFiles(const std::string& latest_path,
+                             const std::string& current_path,
+                             const ApiCheckOptions& options,
+                             ApiCheckReport* report) {
+  ApiFileReader latest_reader, current_reader;
+  if (auto res = latest_reader.Open(latest_path); !res.ok()) return res;
+  if (auto res = current_reader.Open(current_path); !res.ok()) return res;
+
+  // Only one module of each file is held at a time, and the messages are
+  // reused so that their storage is too.
+  sysprop::Properties latest_props, current_props;
+  std::string latest_module, current_module;
+  bool has_current = false;
+  bool current_ended = false;
+
+  PropIndex props;
+  std::vector<ApiCheckReport> reports(1);
+
+  for (;;) {
+    auto latest_res = NextSortedModule(&latest_reader, latest_path,
+                                       &latest_module, &latest_props);
+    if (!latest_res.ok()) return latest_res.error();
+    if (!*latest_res) break;
+
+    // Skip the modules that were added to current.
+    while (!current_ended &&
+           (!has_current || current_props.module() < latest_props.module())) {
+      auto current_res = NextSortedModule(&current_reader, current_path,
+                                          &current_module, &current_props);
+      if (!current_res.ok()) return current_res.error();
+      has_current = *current_res;
+      current_ended = !*current_res;
+    }
+
+    if (ModuleFingerprintsMatch(options.latest_fingerprints,
+                                options.current_fingerprints,
+                                latest_props.module())) {
+      continue;
+    }
+
+    // As in CompareApis(), a missing module is compared as an empty one.
+    bool found =
+        has_current && current_props.module() == latest_props.module();
+    CompareProps(latest_props,
+                 found ? current_props : sysprop::Properties::default_instance(),
+                 &props, &reports[0]);
+  }
 
-  for (int i = 0; i < current.props_size(); ++i) {
-    propsMap[current.props(i).module()] = current.props(i);
+  // The rest of current is still read, so that it is validated as a whole.
+  while (!current_ended) {
+    auto current_res = NextSortedModule(&current_reader, current_path,
+                                        &current_module, &current_props);
+    if (!current_res.ok()) return current_res.error();
+    current_ended = !*current_res;
   }
 
-  for (int i = 0; i < latest.props_size(); ++i) {
-    // Checking whether propsMap contains latest.props(i)->module() or not
-    // is intentionally skipped to handle the case that latest.props(i) has
-    // only deprecated properties.
-    if (auto res =
-            CompareProps(latest.props(i), propsMap[latest.props(i).module()]);
-        !res.ok()) {
-      return res;
+  return FinishReport(&reports, report);
+}
+
+Result<void> CompareApis(const sysprop::SyspropLibraryApis& latest,
+                         const sysprop::SyspropLibraryApis& current,
+                         const ApiCheckOptions& options,
+                         ApiCheckReport* report) {
+  ApiBaseline baseline;
+  baseline.latest = &latest;
+  baseline.latest_fingerprints = options.latest_fingerprints;
+  baseline.report = report;
+  return std::move(CompareApisWithBaselines({baseline}, current, options)[0]);
+}
+
+std::vector<Result<void>> CompareApisWithBaselines(
+    const std::vector<ApiBaseline>& baselines,
+    const sysprop::SyspropLibraryApis& current,
+    const ApiCheckOptions& options) {
+  // Points into |current|; nothing is copied.
+  ModuleIndex modules;
+  modules.Build(current.props());
+
+  // Modules are compared in contiguous chunks, each with its own scratch index
+  // and report, so that threads share nothing but the read-only inputs. The
+  // chunks of all baselines go to the same pool, so that a large baseline
+  // doesn't leave threads idle after the small ones are done.
+  constexpr size_t kMaxChunks = 64;
+  struct Chunk {
+    const ApiBaseline* baseline;
+    size_t begin;
+    size_t end;
+    ApiCheckReport* report;
+  };
+  std::vector<Chunk> chunks;
+  std::vector<std::vector<ApiCheckReport>> reports(baselines.size());
+  for (size_t b = 0; b < baselines.size(); ++b) {
+    const size_t num_modules = baselines[b].latest->props_size();
+    const size_t num_chunks = std::min(num_modules, kMaxChunks);
+    reports[b].resize(num_chunks);
+    for (size_t i = 0; i < num_chunks; ++i) {
+      chunks.push_back({&baselines[b], num_modules * i / num_chunks,
+                        num_modules * (i + 1) / num_chunks, &reports[b][i]});
     }
   }
 
-  return {};
+  ParallelFor(chunks.size(), options.num_threads, [&](size_t c) {
+    const Chunk& chunk = chunks[c];
+    const sysprop::SyspropLibraryApis& latest = *chunk.baseline->latest;
+    PropIndex props;
+    for (size_t i = chunk.begin; i < chunk.end; ++i) {
+      const sysprop::Properties& latest_props = latest.props(i);
+      if (ModuleFingerprintsMatch(chunk.baseline->latest_fingerprints,
+                                  options.current_fingerprints,
+                                  latest_props.module())) {
+        continue;
+      }
+
+      // A module missing from current is compared as an empty one instead
+      // of being reported right away, to handle the case that latest_props
+      // has only deprecated properties.
+      const sysprop::Properties* found = modules.Find(latest_props.module());
+      const sysprop::Properties& current_props =
+          found ? *found : sysprop::Properties::default_instance();
+
+      CompareProps(latest_props, current_props, &props, chunk.report);
+    }
+  });
+
+  std::vector<Result<void>> ret;
+  ret.reserve(baselines.size());
+  for (size_t b = 0; b < baselines.size(); ++b) {
+    ret.push_back(FinishReport(&reports[b], baselines[b].report));
+  }
+  return ret;
 }
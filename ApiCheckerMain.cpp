@@ -16,49 +16,264 @@
 
 #define LOG_TAG "sysprop_api_checker_main"
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/parseint.h>
+#include <google/protobuf/text_format.h>
 #include <cstdio>
 #include <cstdlib>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <getopt.h>
 
 #include "ApiChecker.h"
 #include "Common.h"
+#include "Parallel.h"
+
+using android::base::Result;
 
 namespace {
 
+struct Arguments {
+  std::vector<std::string> latest_files;
+  std::string current_file;
+  std::vector<std::string> latest_fingerprints_files;
+  std::string current_fingerprints_file;
+  std::vector<std::string> report_files;
+  unsigned num_threads = 0;
+  bool streaming = false;
+};
+
 [[noreturn]] void PrintUsage(const char* exe_name) {
-  std::printf("Usage: %s latest-file current-file\n", exe_name);
+  std::printf(
+      "Usage: %s [--streaming] [--latest-fingerprints file... "
+      "--current-fingerprints file]\n"
+      "       [--jobs n] [--report file...] latest-files... current-file\n"
+      "\n"
+      "Checks current-file against each of the latest files. One file may "
+      "be - to read\nit from stdin.\n"
+      "--streaming reads both files module by module instead of parsing them "
+      "whole,\nwhich keeps memory bounded by the largest module. Modules must "
+      "then be sorted\nby name, as sysprop_api_dump writes them. It takes a "
+      "single latest file.\n"
+      "Given the fingerprints that sysprop_api_dump --fingerprints wrote "
+      "along with\nthe files, modules whose fingerprints match are skipped, "
+      "and latest files aren't\nparsed at all if all of theirs do. "
+      "--latest-fingerprints is given once per latest\nfile, in the same "
+      "order.\n"
+      "All incompatibilities are reported, sorted by module. --report file "
+      "also\nwrites them to file as a text ApiCheckReport message, defined "
+      "in\napi_check.proto. It is given once per latest file, in the same "
+      "order.\n",
+      exe_name);
   std::exit(EXIT_FAILURE);
 }
 
+Result<Arguments> ParseArgs(int argc, char* argv[]) {
+  Arguments ret;
+  for (;;) {
+    static struct option long_options[] = {
+        {"streaming", no_argument, 0, 's'},
+        {"latest-fingerprints", required_argument, 0, 'l'},
+        {"current-fingerprints", required_argument, 0, 'c'},
+        {"report", required_argument, 0, 'r'},
+        {"jobs", required_argument, 0, 'j'},
+        {0, 0, 0, 0},
+    };
+
+    int opt = getopt_long_only(argc, argv, "", long_options, nullptr);
+    if (opt == -1) break;
+
+    switch (opt) {
+      case 's':
+        ret.streaming = true;
+        break;
+      case 'l':
+        ret.latest_fingerprints_files.emplace_back(optarg);
+        break;
+      case 'c':
+        ret.current_fingerprints_file = optarg;
+        break;
+      case 'r':
+        ret.report_files.emplace_back(optarg);
+        break;
+      case 'j':
+        if (!android::base::ParseUint(optarg, &ret.num_threads)) {
+          return Errorf("Invalid number of jobs {}", optarg);
+        }
+        break;
+      default:
+        return Errorf("Invalid arguments");
+    }
+  }
+
+  if (argc - optind < 2) {
+    return Errorf("{} needs at least 2 files", argv[0]);
+  }
+  ret.latest_files.assign(argv + optind, argv + argc - 1);
+  ret.current_file = argv[argc - 1];
+
+  bool reads_stdin = ret.current_file == kStdioFilePath;
+  for (const std::string& latest_file : ret.latest_files) {
+    if (latest_file != kStdioFilePath) continue;
+    if (reads_stdin) {
+      return Errorf("{} can read only one file from stdin", argv[0]);
+    }
+    reads_stdin = true;
+  }
+
+  if (ret.streaming && ret.latest_files.size() > 1) {
+    return Errorf("--streaming takes a single latest file");
+  }
+
+  if (ret.current_fingerprints_file.empty()
+          ? !ret.latest_fingerprints_files.empty()
+          : ret.latest_fingerprints_files.size() != ret.latest_files.size()) {
+    return Errorf("Fingerprints must be given for every file or none");
+  }
+
+  if (!ret.report_files.empty() &&
+      ret.report_files.size() != ret.latest_files.size()) {
+    return Errorf("A report must be given for every latest file or none");
+  }
+
+  return ret;
+}
+
+// Reads the fingerprints written along with |api_file_path| into
+// |fingerprints|, and returns whether they still describe it. If they don't,
+// the modules of the file are compared in full.
+bool ReadFingerprintsOrDie(const std::string& path,
+                           const std::string& api_file_path,
+                           ApiFingerprints* fingerprints) {
+  auto res = ReadApiFingerprintsFor(path, api_file_path, fingerprints);
+  if (!res.ok()) LOG(FATAL) << res.error();
+  if (!*res) {
+    LOG(WARNING) << "fingerprints " << path << " weren't written for "
+                 << api_file_path << "; comparing all of its modules";
+  }
+  return *res;
+}
+
+// Checks the current file against each latest file, returning one result per
+// latest file. Incompatibilities are also stored in |reports|. Other errors
+// are fatal.
+std::vector<Result<void>> Check(
+    const Arguments& args,
+    std::vector<sysprop::api_check::ApiCheckReport>* reports) {
+  const size_t num_baselines = args.latest_files.size();
+  std::vector<Result<void>> ret(num_baselines);
+  reports->resize(num_baselines);
+
+  ApiCheckOptions options;
+  options.num_threads = args.num_threads;
+
+  // Baselines whose fingerprints all match current, the common case, are
+  // compatible without being parsed.
+  // Fingerprints that no longer describe their API file are left out.
+  ApiFingerprints current_fingerprints;
+  std::vector<ApiFingerprints> latest_fingerprints(num_baselines);
+  std::vector<bool> has_latest_fingerprints(num_baselines);
+  std::vector<size_t> pending;
+  if (!args.current_fingerprints_file.empty() &&
+      ReadFingerprintsOrDie(args.current_fingerprints_file, args.current_file,
+                            &current_fingerprints)) {
+    options.current_fingerprints = &current_fingerprints;
+  }
+  for (size_t i = 0; i < num_baselines; ++i) {
+    if (options.current_fingerprints != nullptr) {
+      has_latest_fingerprints[i] = ReadFingerprintsOrDie(
+          args.latest_fingerprints_files[i], args.latest_files[i],
+          &latest_fingerprints[i]);
+      if (has_latest_fingerprints[i] &&
+          FingerprintsMatch(latest_fingerprints[i], current_fingerprints)) {
+        continue;
+      }
+    }
+    pending.push_back(i);
+  }
+  if (pending.empty()) return ret;
+
+  if (args.streaming) {
+    options.latest_fingerprints =
+        has_latest_fingerprints[0] ? &latest_fingerprints[0] : nullptr;
+    ret[0] = CompareApiFiles(args.latest_files[0], args.current_file, options,
+                             &(*reports)[0]);
+    return ret;
+  }
+
+  // The current file and all pending latest files are parsed concurrently,
+  // onto one arena freed all at once.
+  google::protobuf::Arena arena(GetParseArenaOptions());
+  std::vector<const std::string*> paths = {&args.current_file};
+  for (size_t i : pending) paths.push_back(&args.latest_files[i]);
+  std::vector<Result<sysprop::SyspropLibraryApis*>> apis(paths.size());
+  ParallelFor(paths.size(), args.num_threads,
+              [&](size_t i) { apis[i] = ParseApiFile(*paths[i], &arena); });
+
+  for (size_t i = 0; i < paths.size(); ++i) {
+    if (!apis[i].ok()) {
+      LOG(FATAL) << "parsing sysprop_library API file " << *paths[i]
+                 << " failed: " << apis[i].error();
+    }
+  }
+
+  std::vector<ApiBaseline> baselines;
+  for (size_t i = 0; i < pending.size(); ++i) {
+    ApiBaseline baseline;
+    baseline.latest = *apis[i + 1];
+    if (has_latest_fingerprints[pending[i]]) {
+      baseline.latest_fingerprints = &latest_fingerprints[pending[i]];
+    }
+    baseline.report = &(*reports)[pending[i]];
+    baselines.push_back(baseline);
+  }
+
+  std::vector<Result<void>> results =
+      CompareApisWithBaselines(baselines, **apis[0], options);
+  for (size_t i = 0; i < pending.size(); ++i) {
+    ret[pending[i]] = std::move(results[i]);
+  }
+  return ret;
+}
+
 }  // namespace
 
 int main(int argc, char* argv[]) {
-  if (argc != 3) {
-    std::fprintf(stderr, "%s needs 2 arguments\n", argv[0]);
+  Arguments args;
+  if (auto res = ParseArgs(argc, argv); res.ok()) {
+    args = std::move(*res);
+  } else {
+    std::fprintf(stderr, "%s\n", res.error().message().c_str());
     PrintUsage(argv[0]);
   }
 
-  sysprop::SyspropLibraryApis latest, current;
+  std::vector<sysprop::api_check::ApiCheckReport> reports;
+  std::vector<Result<void>> results = Check(args, &reports);
 
-  if (auto res = ParseApiFile(argv[1]); res.ok()) {
-    latest = std::move(*res);
-  } else {
-    LOG(FATAL) << "parsing sysprop_library API file " << argv[1]
-               << " failed: " << res.error();
+  for (size_t i = 0; i < args.report_files.size(); ++i) {
+    std::string text;
+    if (!google::protobuf::TextFormat::PrintToString(reports[i], &text)) {
+      LOG(FATAL) << "dumping report failed";
+    }
+    if (!android::base::WriteStringToFile(text, args.report_files[i])) {
+      PLOG(FATAL) << "writing report to " << args.report_files[i]
+                  << " failed";
+    }
   }
 
-  if (auto res = ParseApiFile(argv[2]); res.ok()) {
-    current = std::move(*res);
-  } else {
-    LOG(FATAL) << "parsing sysprop_library API file " << argv[2]
-               << " failed: " << res.error();
+  // Report failures in argument order.
+  bool failed = false;
+  for (size_t i = 0; i < results.size(); ++i) {
+    if (!results[i].ok()) {
+      LOG(ERROR) << "sysprop_library API check against "
+                 << args.latest_files[i] << " failed:\n"
+                 << results[i].error();
+      failed = true;
+    }
   }
 
-  if (auto res = CompareApis(latest, current); !res.ok()) {
-    LOG(ERROR) << "sysprop_library API check failed:\n" << res.error();
-    return EXIT_FAILURE;
-  }
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
 }
@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ApiDump.h"
+
+#include <unistd.h>
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <google/protobuf/text_format.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include "Common.h"
+
+using android::base::Result;
+
+namespace {
+
+// Sorts |modules| by name and the props of each module by API name, so that
+// the dump doesn't depend on the order of the inputs. Only pointers are
+// moved around.
+Result<void> SortModules(std::vector<sysprop::Properties*>* modules) {
+  std::sort(modules->begin(), modules->end(), [](auto* a, auto* b) {
+    return a->module() < b->module();
+  });
+
+  for (size_t i = 0; i < modules->size(); ++i) {
+    sysprop::Properties* props = (*modules)[i];
+    if (i > 0 && (*modules)[i - 1]->module() == props->module()) {
+      return Errorf("duplicated module name {}", props->module());
+    }
+
+    auto* prop = props->mutable_prop();
+    std::sort(prop->pointer_begin(), prop->pointer_end(),
+              [](auto* a, auto* b) { return a->api_name() < b->api_name(); });
+  }
+
+  return {};
+}
+
+// Writes |res|, described as |what| in errors, to |output_file_path|.
+Result<void> WriteOutput(const std::string& res, const char* what,
+                         const std::string& output_file_path,
+                         std::vector<std::string>* changed_outputs) {
+  if (output_file_path == kStdioFilePath) {
+    if (!android::base::WriteStringToFd(res, STDOUT_FILENO)) {
+      return ErrnoErrorf("writing {} to stdout failed", what);
+    }
+    return {};
+  }
+
+  if (auto write_res = WriteStringToFileIfChanged(res, output_file_path);
+      !write_res.ok()) {
+    return Errorf("writing {} file to {} failed: {}", what, output_file_path,
+                  write_res.error().message());
+  } else if (*write_res && changed_outputs != nullptr) {
+    changed_outputs->push_back(output_file_path);
+  }
+
+  return {};
+}
+
+Result<void> WriteApis(const sysprop::SyspropLibraryApis& api,
+                       const std::string& output_file_path,
+                       std::vector<std::string>* changed_outputs) {
+  std::string res;
+  if (!google::protobuf::TextFormat::PrintToString(api, &res)) {
+    return Errorf("dumping API failed");
+  }
+
+  return WriteOutput(res, "API", output_file_path, changed_outputs);
+}
+
+}  // namespace
+
+Result<void> DumpApis(std::vector<sysprop::Properties> modules,
+                      const std::string& output_file_path,
+                      std::vector<std::string>* changed_outputs) {
+  std::vector<sysprop::Properties*> sorted_modules;
+  for (auto& props : modules) sorted_modules.push_back(&props);
+  if (auto res = SortModules(&sorted_modules); !res.ok()) {
+    return res;
+  }
+
+  sysprop::SyspropLibraryApis api;
+  for (sysprop::Properties* props : sorted_modules) {
+    *api.add_props() = std::move(*props);
+  }
+
+  return WriteApis(api, output_file_path, changed_outputs);
+}
+
+Result<void> DumpApis(const std::vector<sysprop::Properties*>& modules,
+                      google::protobuf::Arena* arena,
+                      const std::string& output_file_path,
+                      std::vector<std::string>* changed_outputs) {
+  std::vector<sysprop::Properties*> sorted_modules = modules;
+  if (auto res = SortModules(&sorted_modules); !res.ok()) {
+    return res;
+  }
+
+  auto* api =
+      google::protobuf::Arena::CreateMessage<sysprop::SyspropLibraryApis>(
+          arena);
+  for (sysprop::Properties* props : sorted_modules) {
+    CHECK_EQ(props->GetArena(), arena);
+    // Both messages being on |arena|, this only adds the pointer.
+    api->mutable_props()->AddAllocated(props);
+  }
+
+  return WriteApis(*api, output_file_path, changed_outputs);
+}
+
+Result<void> DumpApiFingerprints(
+    const std::vector<sysprop::Properties*>& modules,
+    const std::string& api_file_path, const std::string& output_file_path,
+    std::vector<std::string>* changed_outputs) {
+  std::vector<sysprop::Properties*> sorted_modules = modules;
+  if (auto res = SortModules(&sorted_modules); !res.ok()) {
+    return res;
+  }
+
+  auto digest = ComputeFileDigest(api_file_path);
+  if (!digest.ok()) {
+    return Errorf("computing the digest of {} failed: {}", api_file_path,
+                  digest.error().message());
+  }
+
+  std::string res = kApiFileDigestKey;
+  res += ' ';
+  res += *digest;
+  res += '\n';
+  for (const sysprop::Properties* props : sorted_modules) {
+    res += props->module();
+    res += ' ';
+    res += ComputeApiFingerprint(*props);
+    res += '\n';
+  }
+
+  return WriteOutput(res, "fingerprints", output_file_path, changed_outputs);
+}
@@ -16,60 +16,115 @@
 
 #define LOG_TAG "sysprop_api_dump_main"
 
-#include <android-base/file.h>
 #include <android-base/logging.h>
-#include <google/protobuf/text_format.h>
 
-#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
-#include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
+#include <getopt.h>
+
+#include "ApiDump.h"
 #include "Common.h"
 
+using android::base::Result;
+
 namespace {
 
+struct Arguments {
+  std::string output_file;
+  std::string fingerprints_file;
+  std::vector<std::string> input_files;
+};
+
 [[noreturn]] void PrintUsage(const char* exe_name) {
-  std::printf("Usage: %s output_file sysprop_files...\n", exe_name);
+  std::printf(
+      "Usage: %s [--fingerprints file] output_file sysprop_files...\n"
+      "\n"
+      "An output_file named - writes to stdout, and a sysprop file named - is "
+      "read\nfrom stdin.\n"
+      "--fingerprints file also writes a fingerprint of each module, which "
+      "lets\nsysprop_api_checker skip the modules that didn't change. It "
+      "needs output_file\nnot to be -.\n",
+      exe_name);
   std::exit(EXIT_FAILURE);
 }
 
+Result<Arguments> ParseArgs(int argc, char* argv[]) {
+  Arguments ret;
+  for (;;) {
+    static struct option long_options[] = {
+        {"fingerprints", required_argument, 0, 'f'},
+        {0, 0, 0, 0},
+    };
+
+    int opt = getopt_long_only(argc, argv, "", long_options, nullptr);
+    if (opt == -1) break;
+
+    switch (opt) {
+      case 'f':
+        ret.fingerprints_file = optarg;
+        break;
+      default:
+        return Errorf("Invalid arguments");
+    }
+  }
+
+  if (argc - optind < 2) {
+    return Errorf("{} needs at least 2 arguments", argv[0]);
+  }
+  ret.output_file = argv[optind];
+  ret.input_files.assign(argv + optind + 1, argv + argc);
+
+  // The fingerprints record the digest of the output file, which is read back.
+  if (!ret.fingerprints_file.empty() && ret.output_file == kStdioFilePath) {
+    return Errorf("--fingerprints can't be used when writing to stdout");
+  }
+
+  return ret;
+}
+
 }  // namespace
 
 int main(int argc, char* argv[]) {
-  if (argc < 3) {
-    std::fprintf(stderr, "%s needs at least 2 arguments\n", argv[0]);
+  Arguments args;
+  if (auto res = ParseArgs(argc, argv); res.ok()) {
+    args = std::move(*res);
+  } else {
+    std::fprintf(stderr, "%s\n", res.error().message().c_str());
     PrintUsage(argv[0]);
   }
 
-  sysprop::SyspropLibraryApis api;
-  std::map<std::string, sysprop::Properties> modules;
+  google::protobuf::Arena arena(GetParseArenaOptions());
+  std::vector<sysprop::Properties*> modules;
+  bool reads_stdin = false;
 
-  for (int i = 2; i < argc; ++i) {
-    if (auto res = ParseProps(argv[i]); res.ok()) {
-      if (!modules.emplace(res->module(), *res).second) {
-        LOG(FATAL) << "duplicated module name " << res->module();
-      }
+  for (const std::string& input_file : args.input_files) {
+    if (input_file == kStdioFilePath) {
+      if (reads_stdin) LOG(FATAL) << "stdin can only be read once";
+      reads_stdin = true;
+    }
+
+    if (auto res = ParseProps(input_file, &arena); res.ok()) {
+      modules.push_back(*res);
     } else {
-      LOG(FATAL) << "parsing sysprop file " << argv[i]
+      LOG(FATAL) << "parsing sysprop file " << input_file
                  << " failed: " << res.error();
     }
   }
 
-  for (auto& [name, props] : modules) {
-    // Sort properties to normalize
-    std::sort(props.mutable_prop()->begin(), props.mutable_prop()->end(),
-              [](auto& a, auto& b) { return a.api_name() < b.api_name(); });
-    *api.add_props() = std::move(props);
-  }
-
-  std::string res;
-  if (!google::protobuf::TextFormat::PrintToString(api, &res)) {
-    LOG(FATAL) << "dumping API failed";
+  if (auto res = DumpApis(modules, &arena, args.output_file); !res.ok()) {
+    LOG(FATAL) << res.error();
   }
 
-  if (!android::base::WriteStringToFile(res, argv[1])) {
-    PLOG(FATAL) << "writing API file to " << argv[1] << " failed";
+  // The modules are still valid, being owned by |arena| through the dump.
+  if (!args.fingerprints_file.empty()) {
+    if (auto res = DumpApiFingerprints(modules, args.output_file,
+                                       args.fingerprints_file);
+        !res.ok()) {
+      LOG(FATAL) << res.error();
+    }
   }
 }
@@ -21,21 +21,106 @@
 #endif
 #define LOG_TAG "sysprop_gen"
 
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
 #include <cstdarg>
 #include <cstdio>
-#include <vector>
+#include <cstring>
+#include <iterator>
 
 #include <android-base/logging.h>
 
-CodeWriter::CodeWriter(std::string indent) : indent_(std::move(indent)) {
+using android::base::Result;
+
+FdCodeSink::FdCodeSink(int fd, size_t buffer_size)
+    : fd_(fd), buffer_(buffer_size) {
+}
+
+void FdCodeSink::Append(std::string_view code) {
+  if (errno_ != 0) return;
+
+  if (code.size() <= buffer_.size() - buffered_) {
+    std::memcpy(buffer_.data() + buffered_, code.data(), code.size());
+    buffered_ += code.size();
+    return;
+  }
+
+  iovec iov[] = {
+      {buffer_.data(), buffered_},
+      {const_cast<char*>(code.data()), code.size()},
+  };
+  WriteFully(iov, std::size(iov));
+  buffered_ = 0;
+}
+
+Result<void> FdCodeSink::Flush() {
+  if (errno_ == 0 && buffered_ > 0) {
+    iovec iov = {buffer_.data(), buffered_};
+    WriteFully(&iov, 1);
+    buffered_ = 0;
+  }
+
+  if (errno_ != 0) {
+    errno = errno_;
+    return ErrnoErrorf("Writing generated code failed");
+  }
+  return {};
+}
+
+void FdCodeSink::WriteFully(iovec* iov, int iovcnt) {
+  while (iovcnt > 0) {
+    ssize_t n = TEMP_FAILURE_RETRY(writev(fd_, iov, iovcnt));
+    if (n < 0) {
+      errno_ = errno;
+      return;
+    }
+
+    // Skip what has been written, which may end in the middle of an iovec.
+    size_t written = n;
+    while (iovcnt > 0 && written >= iov->iov_len) {
+      written -= iov->iov_len;
+      ++iov;
+      --iovcnt;
+    }
+    if (iovcnt > 0) {
+      iov->iov_base = static_cast<char*>(iov->iov_base) + written;
+      iov->iov_len -= written;
+    }
+  }
+}
+
+CodeWriter::CodeWriter(std::string indent)
+    : CodeWriter(std::move(indent), nullptr) {
+}
+
+CodeWriter::CodeWriter(std::string indent, CodeSink* sink)
+    : sink_(sink ? sink : &string_sink_),
+      indent_(std::move(indent)),
+      indents_(1),
+      scratch_(256, '\0') {
+}
+
+const std::string& CodeWriter::Code() const {
+  CHECK(sink_ == &string_sink_) << "The code was sent to another sink";
+  return string_sink_.Code();
 }
 
 void CodeWriter::Write(const char* format, ...) {
+  // Most calls are plain snippets with nothing to format.
+  if (std::strchr(format, '%') == nullptr) {
+    Write(std::string_view(format));
+    return;
+  }
+
   va_list ap, apc;
   va_start(ap, format);
   va_copy(apc, ap);
 
-  int size = std::vsnprintf(nullptr, 0, format, ap);
+  // Format straight into the scratch buffer, and only format a second time
+  // if it turns out to be too small.
+  int size = std::vsnprintf(scratch_.data(), scratch_.size() + 1, format, ap);
   va_end(ap);
 
   if (size < 0) {
@@ -43,33 +128,47 @@ void CodeWriter::Write(const char* format, ...) {
     PLOG(FATAL) << "vsnprintf failed";
   }
 
-  std::vector<char> buf(size + 1);
-  if (std::vsnprintf(buf.data(), size + 1, format, apc) < 0) {
-    va_end(apc);
-    PLOG(FATAL) << "vsnprintf failed";
+  if (static_cast<size_t>(size) > scratch_.size()) {
+    scratch_.resize(size);
+    if (std::vsnprintf(scratch_.data(), size + 1, format, apc) < 0) {
+      va_end(apc);
+      PLOG(FATAL) << "vsnprintf failed";
+    }
   }
   va_end(apc);
 
-  for (int i = 0; i < size; ++i) {
-    char ch = buf[i];
-    if (ch == '\n') {
-      start_of_line_ = true;
-    } else {
-      if (start_of_line_) {
-        for (int j = 0; j < indent_level_; ++j) {
-          code_ += indent_;
-        }
-        start_of_line_ = false;
-      }
+  Write(std::string_view(scratch_.data(), size));
+}
+
+void CodeWriter::Write(std::string_view code) {
+  while (!code.empty()) {
+    const char* newline =
+        static_cast<const char*>(std::memchr(code.data(), '\n', code.size()));
+    size_t line_size = newline ? newline - code.data() : code.size();
+
+    // Empty lines aren't indented.
+    if (line_size > 0 && start_of_line_) {
+      sink_->Append(indents_[indent_level_]);
     }
-    code_.push_back(ch);
+
+    if (newline == nullptr) {
+      sink_->Append(code);
+      start_of_line_ = false;
+      break;
+    }
+
+    sink_->Append(code.substr(0, line_size + 1));
+    start_of_line_ = true;
+    code.remove_prefix(line_size + 1);
   }
 }
 
 void CodeWriter::Indent() {
   ++indent_level_;
+  if (indents_.size() <= static_cast<size_t>(indent_level_)) {
+    indents_.push_back(indents_.back() + indent_);
+  }
 }
-
 void CodeWriter::Dedent() {
   if (indent_level_ == 0) {
     LOG(FATAL) << "Dedent failed: indent level is already 0";
@@ -16,6 +16,8 @@
 
 #include "Common.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -24,20 +26,33 @@
 #include <cctype>
 #include <cerrno>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <functional>
 #include <initializer_list>
 #include <memory>
-#include <regex>
 #include <string>
+#include <string_view>
 #include <unordered_set>
 #include <vector>
 
 #include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <android-base/unique_fd.h>
+#include <google/protobuf/descriptor.h>
+#include <google/protobuf/descriptor.pb.h>
+#include <google/protobuf/io/tokenizer.h>
+#include <google/protobuf/io/zero_copy_stream_impl_lite.h>
 #include <google/protobuf/text_format.h>
+#include <openssl/sha.h>
 
+#include "CharClass.h"
+#include "CodeWriter.h"
+#include "TextParser.h"
 #include "sysprop.pb.h"
 
 using android::base::Result;
@@ -46,7 +61,7 @@ namespace {
 
 std::string GenerateDefaultPropName(const sysprop::Properties& props,
                                     const sysprop::Property& prop);
-bool IsCorrectIdentifier(const std::string& name);
+bool IsCorrectIdentifier(std::string_view name);
 Result<void> ValidateProp(const sysprop::Properties& props,
                           const sysprop::Property& prop);
 Result<void> ValidateProps(const sysprop::Properties& props);
@@ -73,36 +88,43 @@ std::string GenerateDefaultPropName(const sysprop::Properties& props,
   return ret;
 }
 
-bool IsCorrectIdentifier(const std::string& name) {
-  if (name.empty()) return false;
-  if (std::isalpha(name[0]) == 0 && name[0] != '_') return false;
-
-  return std::all_of(name.begin() + 1, name.end(), [](char ch) {
-    return std::isalnum(ch) != 0 || ch == '_';
-  });
+bool IsCorrectIdentifier(std::string_view name) {
+  return IsNameInClasses(name, kCharAlpha | kCharUnderscore,
+                         kCharAlpha | kCharDigit | kCharUnderscore);
 }
 
-bool IsCorrectName(const std::string& name,
-                   const std::unordered_set<char>& allowed_chars) {
-  if (name.empty()) return false;
-  if (!std::isalpha(*name.begin())) return false;
+bool IsCorrectPropertyName(std::string_view name) {
+  uint8_t classes =
+      kCharAlpha | kCharDigit | kCharUnderscore | kCharDash | kCharDot;
+  if (name.substr(0, 4) == "ctl.") classes |= kCharDollar;
+  return IsNameInClasses(name, kCharAlpha, classes);
+}
 
-  return std::all_of(name.begin(), name.end(), [allowed_chars](char ch) {
-    return std::isalnum(ch) != 0 || allowed_chars.count(ch) != 0;
-  });
+bool IsCorrectApiName(std::string_view name) {
+  return IsNameInClasses(name, kCharAlpha,
+                         kCharAlpha | kCharDigit | kCharUnderscore | kCharDash);
 }
 
-bool IsCorrectPropertyName(const std::string& name) {
-  std::unordered_set<char> allowed{'_', '-', '.'};
-  if (android::base::StartsWith(name, "ctl.")) {
-    allowed.emplace('$');
+// Returns whether |name| is |prefix| followed by at least one character other
+// than a line terminator, like the regex "prefix.+".
+bool HasPrefixAndMore(std::string_view name, std::string_view prefix) {
+  if (name.size() <= prefix.size() || name.substr(0, prefix.size()) != prefix) {
+    return false;
   }
-  return IsCorrectName(name, allowed);
+  return name.find_first_of("\n\r", prefix.size()) == std::string_view::npos;
 }
 
-bool IsCorrectApiName(const std::string& name) {
-  static std::unordered_set<char> allowed{'_', '-'};
-  return IsCorrectName(name, allowed);
+// Returns whether |name| matches
+// "(init\.svc\.|ro\.|persist\.)?<owner>.+|ro\.hardware\..+", where |owner|
+// is "vendor." or "odm.".
+bool IsInOwnerNamespace(std::string_view name, std::string_view owner) {
+  for (std::string_view prefix : {"", "init.svc.", "ro.", "persist."}) {
+    if (name.substr(0, prefix.size()) == prefix &&
+        HasPrefixAndMore(name.substr(prefix.size()), owner)) {
+      return true;
+    }
+  }
+  return HasPrefixAndMore(name, "ro.hardware.");
 }
 
 Result<void> ValidateProp(const sysprop::Properties& props,
@@ -141,15 +163,10 @@ Result<void> ValidateProp(const sysprop::Properties& props,
     return Errorf("Invalid prop name \"{}\"", prop.prop_name());
   }
 
-  static const std::regex vendor_regex(
-      "(init\\.svc\\.|ro\\.|persist\\.)?vendor\\..+|ro\\.hardware\\..+");
-  static const std::regex odm_regex(
-      "(init\\.svc\\.|ro\\.|persist\\.)?odm\\..+|ro\\.hardware\\..+");
-
   switch (props.owner()) {
     case sysprop::Platform:
-      if (std::regex_match(prop_name, vendor_regex) ||
-          std::regex_match(prop_name, odm_regex)) {
+      if (IsInOwnerNamespace(prop_name, "vendor.") ||
+          IsInOwnerNamespace(prop_name, "odm.")) {
         return Errorf(
             "Prop \"{}\" owned by platform cannot have vendor. or odm. "
             "namespace",
@@ -157,14 +174,14 @@ Result<void> ValidateProp(const sysprop::Properties& props,
       }
       break;
     case sysprop::Vendor:
-      if (!std::regex_match(prop_name, vendor_regex)) {
+      if (!IsInOwnerNamespace(prop_name, "vendor.")) {
         return Errorf(
             "Prop \"{}\" owned by vendor should have vendor. namespace",
             prop_name);
       }
       break;
     case sysprop::Odm:
-      if (!std::regex_match(prop_name, odm_regex)) {
+      if (!IsInOwnerNamespace(prop_name, "odm.")) {
         return Errorf("Prop \"{}\" owned by odm should have odm. namespace",
                       prop_name);
       }
@@ -204,15 +221,19 @@ Result<void> ValidateProp(const sysprop::Properties& props,
 }
 
 Result<void> ValidateProps(const sysprop::Properties& props) {
-  std::vector<std::string> names = android::base::Split(props.module(), ".");
-  if (names.size() <= 1) {
+  std::string_view module = props.module();
+  if (module.find('.') == std::string_view::npos) {
     return Errorf("Invalid module name \"{}\"", props.module());
   }
 
-  for (const auto& name : names) {
+  for (size_t begin = 0;;) {
+    size_t end = std::min(module.find('.', begin), module.size());
+    std::string_view name = module.substr(begin, end - begin);
     if (!IsCorrectIdentifier(name)) {
       return Errorf("Invalid name \"{}\" in module", name);
     }
+    if (end == module.size()) break;
+    begin = end + 1;
   }
 
   if (props.prop_size() == 0) {
@@ -238,7 +259,96 @@ Result<void> ValidateProps(const sysprop::Properties& props) {
   return {};
 }
 
-void SetDefaultValues(sysprop::Properties* props) {
+std::string DescribeInput(const std::string& path) {
+  return path == kStdioFilePath ? "stdin" : "file " + path;
+}
+
+// Returns whether the file at |path| exists and holds exactly |content|.
+bool FileContentEquals(const std::string& path, const std::string& content) {
+  android::base::unique_fd fd(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+  if (fd == -1) return false;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) ||
+      static_cast<uint64_t>(st.st_size) != content.size()) {
+    return false;
+  }
+
+  char buf[64 * 1024];
+  size_t offset = 0;
+  for (;;) {
+    ssize_t n = TEMP_FAILURE_RETRY(read(fd, buf, sizeof(buf)));
+    if (n < 0) return false;
+    if (n == 0) break;
+    if (offset + n > content.size() ||
+        std::memcmp(buf, content.data() + offset, n) != 0) {
+      return false;
+    }
+    offset += n;
+  }
+
+  return offset == content.size();
+}
+
+// Returns whether the file at |path| exists and holds exactly the same bytes
+// as the regular file open at |fd|.
+bool FileContentEquals(const std::string& path, int fd) {
+  android::base::unique_fd other_fd(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+  if (other_fd == -1) return false;
+
+  struct stat st, other_st;
+  if (fstat(fd, &st) != 0 || fstat(other_fd, &other_st) != 0 ||
+      !S_ISREG(other_st.st_mode) || st.st_size != other_st.st_size) {
+    return false;
+  }
+
+  char buf[64 * 1024], other_buf[64 * 1024];
+  for (off_t offset = 0; offset < st.st_size;) {
+    ssize_t n = TEMP_FAILURE_RETRY(pread(fd, buf, sizeof(buf), offset));
+    if (n <= 0 ||
+        !android::base::ReadFullyAtOffset(other_fd, other_buf, n, offset) ||
+        std::memcmp(buf, other_buf, n) != 0) {
+      return false;
+    }
+    offset += n;
+  }
+
+  return true;
+}
+
+// Creates a temporary file next to |path|, so that rename() stays on one
+// filesystem.
+Result<std::pair<android::base::unique_fd, std::string>> CreateTempFileFor(
+    const std::string& path) {
+  std::string temp_path = path + ".tmp.XXXXXX";
+  android::base::unique_fd fd(mkstemp(temp_path.data()));
+  if (fd == -1) {
+    return ErrnoErrorf("Creating temporary file for {} failed", path);
+  }
+  if (fchmod(fd, 0644) != 0) {
+    int saved_errno = errno;
+    unlink(temp_path.c_str());
+    errno = saved_errno;
+    return ErrnoErrorf("Writing to {} failed", temp_path);
+  }
+  return std::pair(std::move(fd), std::move(temp_path));
+}
+
+Result<void> RenameTempFile(const std::string& temp_path,
+                            const std::string& path) {
+  if (rename(temp_path.c_str(), path.c_str()) != 0) {
+    int saved_errno = errno;
+    unlink(temp_path.c_str());
+    errno = saved_errno;
+    return ErrnoErrorf("Renaming {} to {} failed", temp_path, path);
+  }
+  return {};
+}
+
+// Returns whether |props| uses the deprecated System scope, so that callers
+// don't cache it and the warning keeps being printed.
+bool SetDefaultValues(sysprop::Properties* props) {
+  bool uses_deprecated_scope = false;
   for (int i = 0; i < props->prop_size(); ++i) {
     // set each optional field to its default value
     sysprop::Property& prop = *props->mutable_prop(i);
@@ -249,8 +359,377 @@ void SetDefaultValues(sysprop::Properties* props) {
                    << ": System scope is deprecated."
                    << " Please use Public scope instead.";
       prop.set_scope(sysprop::Scope::Public);
+      uses_deprecated_scope = true;
+    }
+  }
+  return uses_deprecated_scope;
+}
+
+// SHA-256 digest of a sequence of fields. Each field is preceded by its size,
+// so that field boundaries are part of the digest.
+class FieldHasher {
+ public:
+  FieldHasher() { SHA256_Init(&ctx_); }
+
+  void Update(std::string_view field) {
+    uint64_t size = field.size();
+    SHA256_Update(&ctx_, &size, sizeof(size));
+    SHA256_Update(&ctx_, field.data(), field.size());
+  }
+
+  void Update(int64_t field) {
+    Update(std::string_view(reinterpret_cast<const char*>(&field),
+                            sizeof(field)));
+  }
+
+  // Returns the SHA256_DIGEST_LENGTH bytes of the digest. No field can be
+  // added afterwards.
+  std::string Digest() {
+    std::string digest(SHA256_DIGEST_LENGTH, '\0');
+    SHA256_Final(reinterpret_cast<uint8_t*>(digest.data()), &ctx_);
+    return digest;
+  }
+
+  // Same as Digest(), as lowercase hex digits.
+  std::string Hex() { return ToHex(Digest()); }
+
+  static std::string ToHex(std::string_view digest) {
+    std::string hex;
+    hex.reserve(digest.size() * 2);
+    for (char c : digest) {
+      android::base::StringAppendF(&hex, "%02x", static_cast<uint8_t>(c));
+    }
+    return hex;
+  }
+
+ private:
+  SHA256_CTX ctx_;
+};
+
+// Bump whenever parsing, validation or default values change in a way that
+// affects the parsed messages, so that stale cache entries are ignored.
+// Changes to sysprop.proto are covered by GetParseCacheSchema() instead.
+constexpr const char* kParseCacheVersion = "sysprop-parse-cache-1";
+
+// Returns the serialized descriptor of sysprop.proto as built into this
+// binary, so that cache entries written against another schema are ignored.
+const std::string& GetParseCacheSchema() {
+  static const std::string schema = [] {
+    google::protobuf::FileDescriptorProto file;
+    sysprop::Properties::descriptor()->file()->CopyTo(&file);
+    return file.SerializeAsString();
+  }();
+  return schema;
+}
+
+// A parse cache entry holds the digest it is named after, the size of the
+// serialized message and the message itself, so that entries that were
+// truncated or written for other contents are never used.
+struct ParseCacheEntry {
+  std::string path;
+  std::string digest;
+};
+
+constexpr size_t kParseCacheHeaderSize =
+    SHA256_DIGEST_LENGTH + sizeof(uint64_t);
+
+// Returns the cache entry for |file_contents| parsed as |kind|, with an empty
+// path if the cache is disabled. The cache is enabled by setting
+// SYSPROP_CACHE_DIR, and entries are named after a SHA-256 digest of the
+// parser version, the sysprop.proto schema, the message kind and the input
+// contents.
+ParseCacheEntry GetParseCacheEntry(const char* kind,
+                                   std::string_view file_contents) {
+  const char* cache_dir = getenv("SYSPROP_CACHE_DIR");
+  if (cache_dir == nullptr || *cache_dir == '\0') return {};
+
+  FieldHasher hasher;
+  hasher.Update(kParseCacheVersion);
+  hasher.Update(GetParseCacheSchema());
+  hasher.Update(kind);
+  hasher.Update(file_contents);
+
+  ParseCacheEntry entry;
+  entry.digest = hasher.Digest();
+  entry.path =
+      std::string(cache_dir) + "/" + FieldHasher::ToHex(entry.digest) + ".pb";
+  return entry;
+}
+
+// Fills |message| from |entry|, if there is a valid one.
+bool ReadParseCache(const ParseCacheEntry& entry,
+                    google::protobuf::Message* message) {
+  if (entry.path.empty()) return false;
+
+  std::string contents;
+  if (!android::base::ReadFileToString(entry.path, &contents)) return false;
+  if (contents.size() < kParseCacheHeaderSize ||
+      contents.compare(0, SHA256_DIGEST_LENGTH, entry.digest) != 0) {
+    return false;
+  }
+
+  uint64_t size;
+  memcpy(&size, contents.data() + SHA256_DIGEST_LENGTH, sizeof(size));
+  if (size != contents.size() - kParseCacheHeaderSize) return false;
+
+  return message->ParseFromArray(contents.data() + kParseCacheHeaderSize,
+                                 static_cast<int>(size));
+}
+
+// Stores |message| as |entry|. Failures only cost a later cache miss, so they
+// are ignored.
+void WriteParseCache(const ParseCacheEntry& entry,
+                     const google::protobuf::Message& message) {
+  if (entry.path.empty()) return;
+
+  std::string serialized;
+  if (!message.SerializeToString(&serialized)) return;
+
+  uint64_t size = serialized.size();
+  std::string contents = entry.digest;
+  contents.append(reinterpret_cast<const char*>(&size), sizeof(size));
+  contents += serialized;
+
+  mkdir(android::base::Dirname(entry.path).c_str(), 0755);
+  (void)WriteStringToFileIfChanged(contents, entry.path);
+}
+
+// Contents of an input file, or of stdin if the path is kStdioFilePath.
+// Regular files are mapped into memory so that they are parsed in place
+// instead of being copied into a buffer first.
+class InputContents {
+ public:
+  InputContents() = default;
+  InputContents(const InputContents&) = delete;
+  InputContents& operator=(const InputContents&) = delete;
+  ~InputContents() {
+    if (mapped_ != nullptr) munmap(mapped_, mapped_size_);
+  }
+
+  Result<void> Read(const std::string& path) {
+    android::base::unique_fd owned_fd;
+    int fd = STDIN_FILENO;
+    if (path != kStdioFilePath) {
+      owned_fd.reset(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+      if (owned_fd == -1) return ErrnoErrorf("Error reading file {}", path);
+      fd = owned_fd.get();
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+      void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapped != MAP_FAILED) {
+        mapped_ = mapped;
+        mapped_size_ = st.st_size;
+        return {};
+      }
+    }
+
+    // Pipes and other streams, or files that can't be mapped.
+    if (!android::base::ReadFdToString(fd, &buffer_)) {
+      return ErrnoErrorf("Error reading {}", DescribeInput(path));
     }
+    return {};
   }
+
+  std::string_view contents() const {
+    if (mapped_ != nullptr) {
+      return std::string_view(static_cast<const char*>(mapped_), mapped_size_);
+    }
+    return buffer_;
+  }
+
+ private:
+  void* mapped_ = nullptr;
+  size_t mapped_size_ = 0;
+  std::string buffer_;
+};
+
+// Keeps the first error reported by TextFormat::Parser.
+class FirstErrorCollector : public google::protobuf::io::ErrorCollector {
+ public:
+  void AddError(int line, google::protobuf::io::ColumnNumber column,
+                const std::string& message) override {
+    if (!error_.empty()) return;
+    // TextFormat counts lines and columns from zero.
+    error_ = android::base::StringPrintf("%d:%d: %s", line + 1, column + 1,
+                                         message.c_str());
+  }
+
+  const std::string& error() const { return error_; }
+
+ private:
+  std::string error_;
+};
+
+// Parses |contents| in place, without copying it into a std::string. The
+// hand-written parser handles the common cases; anything it doesn't
+// understand goes through TextFormat, whose error is the one reported: the
+// hand-written parser also gives up on valid syntax it doesn't support, so its
+// error may point at correct input before the actual mistake.
+template <typename Message>
+Result<void> ParseTextFormat(std::string_view contents, Message* message) {
+  if (FastParseTextFormat(contents, message).ok()) return {};
+
+  message->Clear();
+  google::protobuf::io::ArrayInputStream input(contents.data(),
+                                               contents.size());
+  FirstErrorCollector errors;
+  google::protobuf::TextFormat::Parser parser;
+  parser.RecordErrorsTo(&errors);
+  if (!parser.Parse(&input, message)) return Errorf("{}", errors.error());
+  return {};
+}
+
+// Parses |contents| into |ret|, then validates it and sets default values.
+// |contents| is described as |source| in errors.
+Result<void> ParsePropsContents(std::string_view contents,
+                                const std::string& source,
+                                sysprop::Properties* ret,
+                                bool* uses_deprecated_scope) {
+  if (auto res = ParseTextFormat(contents, ret); !res.ok()) {
+    return Errorf("Error parsing {}: {}", source, res.error().message());
+  }
+
+  if (auto res = ValidateProps(*ret); !res.ok()) {
+    return res.error();
+  }
+
+  *uses_deprecated_scope = SetDefaultValues(ret);
+
+  return {};
+}
+
+// Same as ParsePropsContents(), for an API file holding several modules.
+Result<void> ParseApiContents(std::string_view contents,
+                              const std::string& source,
+                              sysprop::SyspropLibraryApis* ret,
+                              bool* uses_deprecated_scope) {
+  if (auto res = ParseTextFormat(contents, ret); !res.ok()) {
+    return Errorf("Error parsing {}: {}", source, res.error().message());
+  }
+
+  // Module names point into |ret|, which outlives the set.
+  std::unordered_set<std::string_view> modules;
+  *uses_deprecated_scope = false;
+
+  for (int i = 0; i < ret->props_size(); ++i) {
+    sysprop::Properties* props = ret->mutable_props(i);
+
+    if (!modules.insert(props->module()).second) {
+      return Errorf("Error parsing {}: duplicated module {}", source,
+                    props->module());
+    }
+
+    if (auto res = ValidateProps(*props); !res.ok()) {
+      return res.error();
+    }
+
+    if (SetDefaultValues(props)) *uses_deprecated_scope = true;
+  }
+
+  return {};
+}
+
+// Returns the position of the first character at or after |pos| that is
+// neither whitespace nor part of a comment.
+size_t SkipSpaceAndComments(std::string_view text, size_t pos) {
+  while (pos < text.size()) {
+    if (text[pos] == '#') {
+      pos = text.find('\n', pos);
+      if (pos == std::string_view::npos) return text.size();
+    } else if (!isspace(static_cast<unsigned char>(text[pos]))) {
+      break;
+    }
+    ++pos;
+  }
+  return pos;
+}
+
+enum class ScanResult { kComplete, kIncomplete, kInvalid };
+
+// Scans the top-level field starting at |text[pos]| of an API file, which
+// must be "props { ... }". On success, |*body| is set to what is between the
+// delimiters and |*end| to the position following the field. kIncomplete
+// means that |text| ends before the field does.
+ScanResult ScanModuleField(std::string_view text, size_t pos,
+                           std::string_view* body, size_t* end,
+                           std::string* error) {
+  size_t name_end = pos;
+  while (name_end < text.size() &&
+         IsCharInClasses(text[name_end], kCharAlpha | kCharDigit |
+                                             kCharUnderscore)) {
+    ++name_end;
+  }
+  if (name_end == text.size()) return ScanResult::kIncomplete;
+
+  std::string_view name = text.substr(pos, name_end - pos);
+  if (name != "props") {
+    *error = "expected \"props\" but got \"" + std::string(name) + "\"";
+    return ScanResult::kInvalid;
+  }
+
+  pos = SkipSpaceAndComments(text, name_end);
+  if (pos < text.size() && text[pos] == ':') {
+    pos = SkipSpaceAndComments(text, pos + 1);
+  }
+  if (pos == text.size()) return ScanResult::kIncomplete;
+  if (text[pos] != '{' && text[pos] != '<') {
+    *error = "expected \"{\" after \"props\"";
+    return ScanResult::kInvalid;
+  }
+
+  size_t body_begin = pos + 1;
+  int depth = 0;
+  while (pos < text.size()) {
+    char ch = text[pos];
+    if (ch == '"' || ch == '\'') {
+      for (++pos; pos < text.size() && text[pos] != ch; ++pos) {
+        if (text[pos] == '\\') ++pos;
+      }
+    } else if (ch == '#') {
+      pos = text.find('\n', pos);
+      if (pos == std::string_view::npos) break;
+    } else if (ch == '{' || ch == '<') {
+      ++depth;
+    } else if ((ch == '}' || ch == '>') && --depth == 0) {
+      *body = text.substr(body_begin, pos - body_begin);
+      *end = pos + 1;
+      return ScanResult::kComplete;
+    }
+    ++pos;
+  }
+  return ScanResult::kIncomplete;
+}
+
+// Reads |input_file_path| and parses it into |ret|, going through the parse
+// cache. |kind| tells apart the cache entries of each message type.
+template <typename Message>
+Result<void> ParseInputFile(
+    const std::string& input_file_path, const char* kind,
+    Result<void> (*parse_contents)(std::string_view, const std::string&,
+                                   Message*, bool*),
+    Message* ret) {
+  InputContents input;
+
+  if (auto res = input.Read(input_file_path); !res.ok()) {
+    return res.error();
+  }
+
+  ParseCacheEntry cache_entry = GetParseCacheEntry(kind, input.contents());
+  if (ReadParseCache(cache_entry, ret)) return {};
+
+  bool uses_deprecated_scope = false;
+  if (auto res = parse_contents(input.contents(),
+                                DescribeInput(input_file_path), ret,
+                                &uses_deprecated_scope);
+      !res.ok()) {
+    return res.error();
+  }
+
+  if (!uses_deprecated_scope) WriteParseCache(cache_entry, *ret);
+
+  return {};
 }
 
 }  // namespace
@@ -276,56 +755,151 @@ std::string GetModuleName(const sysprop::Properties& props) {
 
 Result<sysprop::Properties> ParseProps(const std::string& input_file_path) {
   sysprop::Properties ret;
-  std::string file_contents;
-
-  if (!android::base::ReadFileToString(input_file_path, &file_contents, true)) {
-    return ErrnoErrorf("Error reading file {}", input_file_path);
+  if (auto res = ParseInputFile(input_file_path, "Properties",
+                                &ParsePropsContents, &ret);
+      !res.ok()) {
+    return res.error();
   }
+  return ret;
+}
 
-  if (!google::protobuf::TextFormat::ParseFromString(file_contents, &ret)) {
-    return Errorf("Error parsing file {}", input_file_path);
+Result<sysprop::Properties*> ParseProps(const std::string& input_file_path,
+                                        google::protobuf::Arena* arena) {
+  auto* ret = google::protobuf::Arena::CreateMessage<sysprop::Properties>(arena);
+  if (auto res = ParseInputFile(input_file_path, "Properties",
+                                &ParsePropsContents, ret);
+      !res.ok()) {
+    return res.error();
   }
+  return ret;
+}
 
-  if (auto res = ValidateProps(ret); !res.ok()) {
+Result<sysprop::Properties> ParsePropsFromString(std::string_view contents) {
+  sysprop::Properties ret;
+  bool uses_deprecated_scope = false;
+  if (auto res = ParsePropsContents(contents, "sysprop contents", &ret,
+                                    &uses_deprecated_scope);
+      !res.ok()) {
     return res.error();
   }
-
-  SetDefaultValues(&ret);
-
   return ret;
 }
 
 Result<sysprop::SyspropLibraryApis> ParseApiFile(
     const std::string& input_file_path) {
   sysprop::SyspropLibraryApis ret;
-  std::string file_contents;
+  if (auto res = ParseInputFile(input_file_path, "SyspropLibraryApis",
+                                &ParseApiContents, &ret);
+      !res.ok()) {
+    return res.error();
+  }
+  return ret;
+}
 
-  if (!android::base::ReadFileToString(input_file_path, &file_contents, true)) {
-    return ErrnoErrorf("Error reading file {}", input_file_path);
+Result<sysprop::SyspropLibraryApis*> ParseApiFile(
+    const std::string& input_file_path, google::protobuf::Arena* arena) {
+  auto* ret =
+      google::protobuf::Arena::CreateMessage<sysprop::SyspropLibraryApis>(
+          arena);
+  if (auto res = ParseInputFile(input_file_path, "SyspropLibraryApis",
+                                &ParseApiContents, ret);
+      !res.ok()) {
+    return res.error();
   }
+  return ret;
+}
 
-  if (!google::protobuf::TextFormat::ParseFromString(file_contents, &ret)) {
-    return Errorf("Error parsing file {}", input_file_path);
+Result<sysprop::SyspropLibraryApis> ParseApiFileFromString(
+    std::string_view contents) {
+  sysprop::SyspropLibraryApis ret;
+  bool uses_deprecated_scope = false;
+  if (auto res = ParseApiContents(contents, "API file contents", &ret,
+                                  &uses_deprecated_scope);
+      !res.ok()) {
+    return res.error();
   }
+  return ret;
+}
 
-  std::unordered_set<std::string> modules;
+Result<void> ApiFileReader::Open(const std::string& file_path) {
+  source_ = DescribeInput(file_path);
+  if (file_path == kStdioFilePath) {
+    fd_ = STDIN_FILENO;
+    return {};
+  }
 
-  for (int i = 0; i < ret.props_size(); ++i) {
-    sysprop::Properties* props = ret.mutable_props(i);
+  owned_fd_.reset(open(file_path.c_str(), O_RDONLY | O_CLOEXEC));
+  if (owned_fd_ == -1) return ErrnoErrorf("Error reading file {}", file_path);
+  fd_ = owned_fd_.get();
+  return {};
+}
 
-    if (!modules.insert(props->module()).second) {
-      return Errorf("Error parsing file {}: duplicated module {}",
-                    input_file_path, props->module());
+Result<bool> ApiFileReader::Next(sysprop::Properties* props) {
+  for (;;) {
+    std::string_view text(buffer_);
+    size_t field_begin = SkipSpaceAndComments(text, pos_);
+
+    std::string_view body;
+    size_t field_end = 0;
+    std::string error;
+    ScanResult result = field_begin == text.size()
+                            ? ScanResult::kIncomplete
+                            : ScanModuleField(text, field_begin, &body,
+                                              &field_end, &error);
+
+    if (result == ScanResult::kComplete) {
+      int field_line =
+          line_ + std::count(text.begin() + pos_, text.begin() + field_begin,
+                             '\n');
+      line_ = field_line + std::count(text.begin() + field_begin,
+                                      text.begin() + field_end, '\n');
+      pos_ = field_end;
+
+      props->Clear();
+      bool uses_deprecated_scope = false;
+      if (auto res = ParsePropsContents(
+              body, source_ + ", module at line " + std::to_string(field_line),
+              props, &uses_deprecated_scope);
+          !res.ok()) {
+        return res.error();
+      }
+      return true;
     }
 
-    if (auto res = ValidateProps(*props); !res.ok()) {
-      return res.error();
+    if (result == ScanResult::kInvalid) {
+      int field_line =
+          line_ + std::count(text.begin() + pos_, text.begin() + field_begin,
+                             '\n');
+      return Errorf("Error parsing {}: line {}: {}", source_, field_line,
+                    error);
     }
 
-    SetDefaultValues(props);
+    if (eof_) {
+      if (field_begin == text.size()) return false;
+      return Errorf("Error parsing {}: unexpected end of input", source_);
+    }
+
+    // Drop what has been consumed, then read at least as much as is buffered
+    // so that rescanning a module larger than a read stays linear overall.
+    buffer_.erase(0, pos_);
+    pos_ = 0;
+    size_t old_size = buffer_.size();
+    buffer_.resize(old_size + std::max<size_t>(64 * 1024, old_size));
+    ssize_t n = TEMP_FAILURE_RETRY(
+        read(fd_, buffer_.data() + old_size, buffer_.size() - old_size));
+    if (n < 0) return ErrnoErrorf("Error reading {}", source_);
+    buffer_.resize(old_size + n);
+    if (n == 0) eof_ = true;
   }
+}
 
-  return ret;
+google::protobuf::ArenaOptions GetParseArenaOptions() {
+  google::protobuf::ArenaOptions options;
+  // Parsed files are made of many small messages and strings; larger blocks
+  // cut down on the number of blocks the arena allocates.
+  options.start_block_size = 64 * 1024;
+  options.max_block_size = 1024 * 1024;
+  return options;
 }
 
 std::string ToUpper(std::string str) {
@@ -336,7 +910,188 @@ std::string ToUpper(std::string str) {
 }
 
 std::string ApiNameToIdentifier(const std::string& name) {
-  static const std::regex kRegexAllowed{"-|\\."};
-  return (isdigit(name[0]) ? "_" : "") +
-         std::regex_replace(name, kRegexAllowed, "_");
+  std::string ret;
+  ret.reserve(name.size() + 1);
+  if (IsCharInClasses(name[0], kCharDigit)) ret += '_';
+  for (char ch : name) {
+    ret += (ch == '-' || ch == '.') ? '_' : ch;
+  }
+  return ret;
+}
+
+Result<bool> WriteStringToFileIfChanged(const std::string& content,
+                                        const std::string& path) {
+  if (FileContentEquals(path, content)) return false;
+
+  auto temp_file = CreateTempFileFor(path);
+  if (!temp_file.ok()) return temp_file.error();
+  auto& [fd, temp_path] = *temp_file;
+
+  if (!android::base::WriteStringToFd(content, fd)) {
+    int saved_errno = errno;
+    unlink(temp_path.c_str());
+    errno = saved_errno;
+    return ErrnoErrorf("Writing to {} failed", temp_path);
+  }
+  fd.reset();
+
+  if (auto res = RenameTempFile(temp_path, path); !res.ok()) {
+    return res.error();
+  }
+  return true;
+}
+
+Result<bool> WriteGeneratedFileIfChanged(
+    const std::string& path, const std::function<void(CodeSink*)>& generate) {
+  auto temp_file = CreateTempFileFor(path);
+  if (!temp_file.ok()) return temp_file.error();
+  auto& [fd, temp_path] = *temp_file;
+
+  FdCodeSink sink(fd);
+  generate(&sink);
+  if (auto res = sink.Flush(); !res.ok()) {
+    unlink(temp_path.c_str());
+    return Errorf("Writing to {} failed: {}", temp_path,
+                  res.error().message());
+  }
+
+  if (FileContentEquals(path, fd)) {
+    unlink(temp_path.c_str());
+    return false;
+  }
+  fd.reset();
+
+  if (auto res = RenameTempFile(temp_path, path); !res.ok()) {
+    return res.error();
+  }
+  return true;
+}
+
+// Bump whenever the fields hashed by ComputeApiFingerprint() change, so that
+// fingerprints written by older tools never match.
+constexpr const char* kApiFingerprintVersion = "sysprop-api-fingerprint-1";
+
+std::string ComputeApiFingerprint(const sysprop::Properties& props) {
+  std::vector<const sysprop::Property*> sorted_props;
+  sorted_props.reserve(props.prop_size());
+  for (const sysprop::Property& prop : props.prop()) {
+    sorted_props.push_back(&prop);
+  }
+  std::sort(sorted_props.begin(), sorted_props.end(),
+            [](auto* a, auto* b) { return a->api_name() < b->api_name(); });
+
+  FieldHasher hasher;
+  hasher.Update(kApiFingerprintVersion);
+  hasher.Update(props.module());
+  hasher.Update(props.owner());
+  for (const sysprop::Property* prop : sorted_props) {
+    hasher.Update(prop->api_name());
+    hasher.Update(prop->type());
+    hasher.Update(prop->scope());
+    hasher.Update(prop->access());
+    hasher.Update(prop->prop_name());
+    hasher.Update(prop->enum_values());
+    hasher.Update(prop->integer_as_bool());
+    hasher.Update(prop->deprecated());
+  }
+  return hasher.Hex();
+}
+
+Result<std::string> ComputeFileDigest(const std::string& path) {
+  InputContents input;
+  if (auto res = input.Read(path); !res.ok()) {
+    return res.error();
+  }
+
+  std::string_view contents = input.contents();
+  uint8_t digest[SHA256_DIGEST_LENGTH];
+  SHA256(reinterpret_cast<const uint8_t*>(contents.data()), contents.size(),
+         digest);
+  return FieldHasher::ToHex(
+      std::string_view(reinterpret_cast<const char*>(digest), sizeof(digest)));
+}
+
+Result<ApiFingerprints> ReadApiFingerprints(const std::string& path,
+                                            std::string* api_file_digest) {
+  std::string contents;
+  if (!android::base::ReadFileToString(path, &contents, true)) {
+    return ErrnoErrorf("Error reading fingerprints {}", path);
+  }
+
+  ApiFingerprints ret;
+  api_file_digest->clear();
+  std::vector<std::string> lines = android::base::Split(contents, "\n");
+  for (size_t i = 0; i < lines.size(); ++i) {
+    if (lines[i].empty()) continue;
+
+    std::vector<std::string> fields = android::base::Split(lines[i], " ");
+    if (api_file_digest->empty()) {
+      if (fields.size() != 2 || fields[0] != kApiFileDigestKey ||
+          fields[1].empty()) {
+        return Errorf("{}:{}: expected \"{} <digest of the API file>\"", path,
+                      i + 1, kApiFileDigestKey);
+      }
+      *api_file_digest = std::move(fields[1]);
+      continue;
+    }
+
+    if (fields.size() != 2 || fields[0].empty() || fields[1].empty()) {
+      return Errorf("{}:{}: expected a module name and a fingerprint", path,
+                    i + 1);
+    }
+    if (!ret.try_emplace(std::move(fields[0]), std::move(fields[1])).second) {
+      return Errorf("{}:{}: duplicated module {}", path, i + 1, fields[0]);
+    }
+  }
+
+  if (api_file_digest->empty()) {
+    return Errorf("{}: missing the digest of the API file", path);
+  }
+
+  return ret;
+}
+
+Result<bool> ReadApiFingerprintsFor(const std::string& fingerprints_path,
+                                    const std::string& api_file_path,
+                                    ApiFingerprints* fingerprints) {
+  std::string recorded_digest;
+  if (auto res = ReadApiFingerprints(fingerprints_path, &recorded_digest);
+      res.ok()) {
+    *fingerprints = std::move(*res);
+  } else {
+    return res.error();
+  }
+
+  // stdin can't be read twice, so its digest is unknown.
+  if (api_file_path == kStdioFilePath) return false;
+
+  auto digest = ComputeFileDigest(api_file_path);
+  if (!digest.ok()) return digest.error();
+  return *digest == recorded_digest;
+}
+
+Result<void> CheckDistinctOutputPaths(
+    const std::vector<std::string>& output_paths) {
+  std::unordered_set<std::string_view> seen;
+  for (const std::string& path : output_paths) {
+    if (!seen.insert(path).second) {
+      return Errorf("{} would be generated more than once", path);
+    }
+  }
+  return {};
+}
+
+Result<void> WriteChangedOutputsFile(
+    const std::vector<std::string>& changed_outputs, const std::string& path) {
+  std::string content;
+  for (const std::string& output : changed_outputs) {
+    content += output;
+    content += '\n';
+  }
+
+  if (!android::base::WriteStringToFile(content, path)) {
+    return ErrnoErrorf("Writing list of changed outputs to {} failed", path);
+  }
+
+  return {};
 }
@@ -24,11 +24,14 @@
 #include <android-base/strings.h>
 #include <cerrno>
 #include <filesystem>
-#include <regex>
 #include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
 
 #include "CodeWriter.h"
 #include "Common.h"
+#include "ResolvedProps.h"
 #include "sysprop.pb.h"
 
 using android::base::Result;
@@ -37,7 +40,11 @@ namespace {
 
 constexpr const char* kIndent = "    ";
 
-constexpr const char* kCppHeaderIncludes =
+// Rough sizes of the generated code per prop, used to reserve the output.
+constexpr size_t kHeaderBytesPerProp = 128;
+constexpr size_t kSourceBytesPerProp = 384;
+
+constexpr std::string_view kCppHeaderIncludes =
     R"(#include <cstdint>
 #include <optional>
 #include <string>
@@ -45,7 +52,7 @@ constexpr const char* kCppHeaderIncludes =
 
 )";
 
-constexpr const char* kCppSourceIncludes =
+constexpr std::string_view kCppSourceIncludes =
     R"(#include <cctype>
 #include <cerrno>
 #include <cstdio>
@@ -61,7 +68,7 @@ constexpr const char* kCppSourceIncludes =
 
 )";
 
-constexpr const char* kCppParsersAndFormatters =
+constexpr std::string_view kCppParsersAndFormatters =
     R"(template <typename T> constexpr bool is_vector = false;
 
 template <typename T> constexpr bool is_vector<std::vector<T>> = true;
@@ -196,24 +203,11 @@ T GetProp(const char* key) {
 
 )";
 
-const std::regex kRegexDot{"\\."};
-const std::regex kRegexUnderscore{"_"};
-
-std::string GetCppEnumName(const sysprop::Property& prop);
-std::string GetCppPropTypeName(const sysprop::Property& prop);
+std::string GetCppPropTypeName(const ResolvedProperty& prop);
 std::string GetCppNamespace(const sysprop::Properties& props);
 
-std::string GenerateHeader(const sysprop::Properties& props,
-                           sysprop::Scope scope);
-std::string GenerateSource(const sysprop::Properties& props,
-                           const std::string& include_name);
-
-std::string GetCppEnumName(const sysprop::Property& prop) {
-  return ApiNameToIdentifier(prop.api_name()) + "_values";
-}
-
-std::string GetCppPropTypeName(const sysprop::Property& prop) {
-  switch (prop.type()) {
+std::string GetCppPropTypeName(const ResolvedProperty& prop) {
+  switch (prop.type) {
     case sysprop::Boolean:
       return "std::optional<bool>";
     case sysprop::Integer:
@@ -225,7 +219,7 @@ std::string GetCppPropTypeName(const sysprop::Property& prop) {
     case sysprop::String:
       return "std::optional<std::string>";
     case sysprop::Enum:
-      return "std::optional<" + GetCppEnumName(prop) + ">";
+      return "std::optional<" + prop.enum_type_name + ">";
     case sysprop::BooleanList:
       return "std::vector<std::optional<bool>>";
     case sysprop::IntegerList:
@@ -237,35 +231,69 @@ std::string GetCppPropTypeName(const sysprop::Property& prop) {
     case sysprop::StringList:
       return "std::vector<std::optional<std::string>>";
     case sysprop::EnumList:
-      return "std::vector<std::optional<" + GetCppEnumName(prop) + ">>";
+      return "std::vector<std::optional<" + prop.enum_type_name + ">>";
     default:
       __builtin_unreachable();
   }
 }
 
 std::string GetCppNamespace(const sysprop::Properties& props) {
-  return std::regex_replace(props.module(), kRegexDot, "::");
+  std::string ret;
+  for (char ch : props.module()) {
+    if (ch == '.') {
+      ret += "::";
+    } else {
+      ret += ch;
+    }
+  }
+  return ret;
 }
 
+}  // namespace
+
 std::string GenerateHeader(const sysprop::Properties& props,
                            sysprop::Scope scope) {
-  CodeWriter writer(kIndent);
+  return GenerateHeader(ResolveProps(props), scope);
+}
+
+std::string GenerateSource(const sysprop::Properties& props,
+                           const std::string& include_name) {
+  return GenerateSource(ResolveProps(props), include_name);
+}
 
-  writer.Write("%s", kGeneratedFileFooterComments);
+std::string GenerateHeader(const ResolvedProps& resolved,
+                           sysprop::Scope scope) {
+  StringCodeSink sink;
+  GenerateHeader(resolved, scope, &sink);
+  return sink.TakeCode();
+}
+
+std::string GenerateSource(const ResolvedProps& resolved,
+                           const std::string& include_name) {
+  StringCodeSink sink;
+  GenerateSource(resolved, include_name, &sink);
+  return sink.TakeCode();
+}
+
+void GenerateHeader(const ResolvedProps& resolved, sysprop::Scope scope,
+                    CodeSink* sink) {
+  CodeWriter writer(kIndent, sink);
+  writer.Reserve(kCppHeaderIncludes.size() +
+                 resolved.properties.size() * kHeaderBytesPerProp);
+
+  writer.Write(std::string_view(kGeneratedFileFooterComments));
 
   writer.Write("#pragma once\n\n");
-  writer.Write("%s", kCppHeaderIncludes);
+  writer.Write(kCppHeaderIncludes);
 
-  std::string cpp_namespace = GetCppNamespace(props);
+  std::string cpp_namespace = GetCppNamespace(*resolved.props);
   writer.Write("namespace %s {\n\n", cpp_namespace.c_str());
 
   bool first = true;
 
-  for (int i = 0; i < props.prop_size(); ++i) {
-    const sysprop::Property& prop = props.prop(i);
-
+  for (const ResolvedProperty& prop : resolved.properties) {
     // Scope: Internal > Public
-    if (prop.scope() > scope) continue;
+    if (prop.scope > scope) continue;
 
     if (!first) {
       writer.Write("\n");
@@ -273,72 +301,65 @@ std::string GenerateHeader(const sysprop::Properties& props,
       first = false;
     }
 
-    std::string prop_id = ApiNameToIdentifier(prop.api_name());
+    const char* prop_id = prop.identifier.c_str();
     std::string prop_type = GetCppPropTypeName(prop);
 
-    if (prop.type() == sysprop::Enum || prop.type() == sysprop::EnumList) {
-      writer.Write("enum class %s {\n", GetCppEnumName(prop).c_str());
+    if (prop.is_enum) {
+      writer.Write("enum class %s {\n", prop.enum_type_name.c_str());
       writer.Indent();
-      for (const std::string& name :
-           android::base::Split(prop.enum_values(), "|")) {
-        writer.Write("%s,\n", ToUpper(name).c_str());
+      for (const ResolvedEnumValue& value : prop.enum_values) {
+        writer.Write("%s,\n", value.upper_name.c_str());
       }
       writer.Dedent();
       writer.Write("};\n\n");
     }
 
-    if (prop.deprecated()) writer.Write("[[deprecated]] ");
-    writer.Write("%s %s();\n", prop_type.c_str(), prop_id.c_str());
-    if (prop.access() != sysprop::Readonly) {
-      if (prop.deprecated()) writer.Write("[[deprecated]] ");
-      writer.Write("bool %s(const %s& value);\n", prop_id.c_str(),
-                   prop_type.c_str());
+    if (prop.deprecated) writer.Write("[[deprecated]] ");
+    writer.Write("%s %s();\n", prop_type.c_str(), prop_id);
+    if (prop.writable) {
+      if (prop.deprecated) writer.Write("[[deprecated]] ");
+      writer.Write("bool %s(const %s& value);\n", prop_id, prop_type.c_str());
     }
   }
 
   writer.Write("\n}  // namespace %s\n", cpp_namespace.c_str());
-
-  return writer.Code();
 }
 
-std::string GenerateSource(const sysprop::Properties& props,
-                           const std::string& include_name) {
-  CodeWriter writer(kIndent);
-  writer.Write("%s", kGeneratedFileFooterComments);
+void GenerateSource(const ResolvedProps& resolved,
+                    const std::string& include_name, CodeSink* sink) {
+  CodeWriter writer(kIndent, sink);
+  writer.Reserve(kCppSourceIncludes.size() + kCppParsersAndFormatters.size() +
+                 resolved.properties.size() * kSourceBytesPerProp);
+  writer.Write(std::string_view(kGeneratedFileFooterComments));
   writer.Write("#include <%s>\n\n", include_name.c_str());
-  writer.Write("%s", kCppSourceIncludes);
+  writer.Write(kCppSourceIncludes);
 
-  std::string cpp_namespace = GetCppNamespace(props);
+  std::string cpp_namespace = GetCppNamespace(*resolved.props);
 
   writer.Write("namespace {\n\n");
   writer.Write("using namespace %s;\n\n", cpp_namespace.c_str());
   writer.Write("template <typename T> T DoParse(const char* str);\n\n");
 
-  for (int i = 0; i < props.prop_size(); ++i) {
-    const sysprop::Property& prop = props.prop(i);
-    if (prop.type() != sysprop::Enum && prop.type() != sysprop::EnumList) {
-      continue;
-    }
+  for (const ResolvedProperty& prop : resolved.properties) {
+    if (!prop.is_enum) continue;
 
-    std::string prop_id = ApiNameToIdentifier(prop.api_name());
-    std::string enum_name = GetCppEnumName(prop);
+    const char* prop_id = prop.identifier.c_str();
+    const char* enum_name = prop.enum_type_name.c_str();
 
     writer.Write("constexpr const std::pair<const char*, %s> %s_list[] = {\n",
-                 enum_name.c_str(), prop_id.c_str());
+                 enum_name, prop_id);
     writer.Indent();
-    for (const std::string& name :
-         android::base::Split(prop.enum_values(), "|")) {
-      writer.Write("{\"%s\", %s::%s},\n", name.c_str(), enum_name.c_str(),
-                   ToUpper(name).c_str());
+    for (const ResolvedEnumValue& value : prop.enum_values) {
+      writer.Write("{\"%s\", %s::%s},\n", value.name.c_str(), enum_name,
+                   value.upper_name.c_str());
     }
     writer.Dedent();
     writer.Write("};\n\n");
 
     writer.Write("template <>\n");
-    writer.Write("std::optional<%s> DoParse(const char* str) {\n",
-                 enum_name.c_str());
+    writer.Write("std::optional<%s> DoParse(const char* str) {\n", enum_name);
     writer.Indent();
-    writer.Write("for (auto [name, val] : %s_list) {\n", prop_id.c_str());
+    writer.Write("for (auto [name, val] : %s_list) {\n", prop_id);
     writer.Indent();
     writer.Write("if (strcmp(str, name) == 0) {\n");
     writer.Indent();
@@ -351,12 +372,12 @@ std::string GenerateSource(const sysprop::Properties& props,
     writer.Dedent();
     writer.Write("}\n\n");
 
-    if (prop.access() != sysprop::Readonly) {
+    if (prop.writable) {
       writer.Write("std::string FormatValue(std::optional<%s> value) {\n",
-                   enum_name.c_str());
+                   enum_name);
       writer.Indent();
       writer.Write("if (!value) return \"\";\n");
-      writer.Write("for (auto [name, val] : %s_list) {\n", prop_id.c_str());
+      writer.Write("for (auto [name, val] : %s_list) {\n", prop_id);
       writer.Indent();
       writer.Write("if (val == *value) {\n");
       writer.Indent();
@@ -369,47 +390,48 @@ std::string GenerateSource(const sysprop::Properties& props,
       writer.Write(
           "LOG_ALWAYS_FATAL(\"Invalid value %%d for property %s\", "
           "static_cast<std::int32_t>(*value));\n",
-          prop.prop_name().c_str());
+          prop.prop->prop_name().c_str());
 
       writer.Write("__builtin_unreachable();\n");
       writer.Dedent();
       writer.Write("}\n\n");
     }
   }
-  writer.Write("%s", kCppParsersAndFormatters);
+  writer.Write(kCppParsersAndFormatters);
   writer.Write("}  // namespace\n\n");
 
   writer.Write("namespace %s {\n\n", cpp_namespace.c_str());
 
-  for (int i = 0; i < props.prop_size(); ++i) {
+  for (size_t i = 0; i < resolved.properties.size(); ++i) {
     if (i > 0) writer.Write("\n");
 
-    const sysprop::Property& prop = props.prop(i);
-    std::string prop_id = ApiNameToIdentifier(prop.api_name());
+    const ResolvedProperty& prop = resolved.properties[i];
+    const char* prop_id = prop.identifier.c_str();
+    const char* prop_name = prop.prop->prop_name().c_str();
     std::string prop_type = GetCppPropTypeName(prop);
 
-    writer.Write("%s %s() {\n", prop_type.c_str(), prop_id.c_str());
+    writer.Write("%s %s() {\n", prop_type.c_str(), prop_id);
     writer.Indent();
     writer.Write("return GetProp<%s>(\"%s\");\n", prop_type.c_str(),
-                 prop.prop_name().c_str());
+                 prop_name);
     writer.Dedent();
     writer.Write("}\n");
 
-    if (prop.access() != sysprop::Readonly) {
-      writer.Write("\nbool %s(const %s& value) {\n", prop_id.c_str(),
+    if (prop.writable) {
+      writer.Write("\nbool %s(const %s& value) {\n", prop_id,
                    prop_type.c_str());
       writer.Indent();
 
       const char* format_expr = "FormatValue(value).c_str()";
 
       // Specialized formatters here
-      if (prop.type() == sysprop::String) {
+      if (prop.type == sysprop::String) {
         format_expr = "value ? value->c_str() : \"\"";
-      } else if (prop.integer_as_bool()) {
-        if (prop.type() == sysprop::Boolean) {
+      } else if (prop.prop->integer_as_bool()) {
+        if (prop.type == sysprop::Boolean) {
           // optional<bool> -> optional<int>
           format_expr = "FormatValue(std::optional<int>(value)).c_str()";
-        } else if (prop.type() == sysprop::BooleanList) {
+        } else if (prop.type == sysprop::BooleanList) {
           // vector<optional<bool>> -> vector<optional<int>>
           format_expr =
               "FormatValue(std::vector<std::optional<int>>("
@@ -418,24 +440,38 @@ std::string GenerateSource(const sysprop::Properties& props,
       }
 
       writer.Write("return __system_property_set(\"%s\", %s) == 0;\n",
-                   prop.prop_name().c_str(), format_expr);
+                   prop_name, format_expr);
       writer.Dedent();
       writer.Write("}\n");
     }
   }
 
   writer.Write("\n}  // namespace %s\n", cpp_namespace.c_str());
+}
 
-  return writer.Code();
+std::string GetCppOutputBasename(const std::string& input_file_path,
+                                 const sysprop::Properties& props) {
+  if (input_file_path == kStdioFilePath) {
+    return GetModuleName(props) + ".sysprop";
+  }
+  return android::base::Basename(input_file_path);
 }
 
-}  // namespace
+std::vector<std::string> GetCppOutputPaths(const std::string& output_basename,
+                                           const std::string& header_dir,
+                                           const std::string& public_header_dir,
+                                           const std::string& source_output_dir) {
+  return {header_dir + "/" + output_basename + ".h",
+          public_header_dir + "/" + output_basename + ".h",
+          source_output_dir + "/" + output_basename + ".cpp"};
+}
 
 Result<void> GenerateCppFiles(const std::string& input_file_path,
                               const std::string& header_dir,
                               const std::string& public_header_dir,
                               const std::string& source_output_dir,
-                              const std::string& include_name) {
+                              const std::string& include_name,
+                              std::vector<std::string>* changed_outputs) {
   sysprop::Properties props;
 
   if (auto res = ParseProps(input_file_path); res.ok()) {
@@ -444,11 +480,27 @@ Result<void> GenerateCppFiles(const std::string& input_file_path,
     return res.error();
   }
 
-  std::string output_basename = android::base::Basename(input_file_path);
+  std::string output_basename = GetCppOutputBasename(input_file_path, props);
+  return GenerateCppFiles(
+      props, output_basename, header_dir, public_header_dir, source_output_dir,
+      include_name.empty() ? output_basename + ".h" : include_name,
+      changed_outputs);
+}
 
-  for (auto&& [scope, dir] : {
-           std::pair(sysprop::Internal, header_dir),
-           std::pair(sysprop::Public, public_header_dir),
+Result<void> GenerateCppFiles(const sysprop::Properties& props,
+                              const std::string& output_basename,
+                              const std::string& header_dir,
+                              const std::string& public_header_dir,
+                              const std::string& source_output_dir,
+                              const std::string& include_name,
+                              std::vector<std::string>* changed_outputs) {
+  ResolvedProps resolved = ResolveProps(props);
+  std::vector<std::string> output_paths = GetCppOutputPaths(
+      output_basename, header_dir, public_header_dir, source_output_dir);
+
+  for (auto&& [scope, dir, path] : {
+           std::tuple(sysprop::Internal, header_dir, output_paths[0]),
+           std::tuple(sysprop::Public, public_header_dir, output_paths[1]),
        }) {
     std::error_code ec;
     std::filesystem::create_directories(dir, ec);
@@ -456,19 +508,29 @@ Result<void> GenerateCppFiles(const std::string& input_file_path,
       return Errorf("Creating directory to {} failed: {}", dir, ec.message());
     }
 
-    std::string path = dir + "/" + output_basename + ".h";
-    std::string result = GenerateHeader(props, scope);
+    sysprop::Scope header_scope = scope;
+    auto res = WriteGeneratedFileIfChanged(path, [&](CodeSink* sink) {
+      GenerateHeader(resolved, header_scope, sink);
+    });
 
-    if (!android::base::WriteStringToFile(result, path)) {
-      return ErrnoErrorf("Writing generated header to {} failed", path);
+    if (!res.ok()) {
+      return Errorf("Writing generated header to {} failed: {}", path,
+                    res.error().message());
+    } else if (*res && changed_outputs != nullptr) {
+      changed_outputs->push_back(path);
     }
   }
 
-  std::string source_path = source_output_dir + "/" + output_basename + ".cpp";
-  std::string source_result = GenerateSource(props, include_name);
+  const std::string& source_path = output_paths[2];
+  auto res = WriteGeneratedFileIfChanged(source_path, [&](CodeSink* sink) {
+    GenerateSource(resolved, include_name, sink);
+  });
 
-  if (!android::base::WriteStringToFile(source_result, source_path)) {
-    return ErrnoErrorf("Writing generated source to {} failed", source_path);
+  if (!res.ok()) {
+    return Errorf("Writing generated source to {} failed: {}", source_path,
+                  res.error().message());
+  } else if (*res && changed_outputs != nullptr) {
+    changed_outputs->push_back(source_path);
   }
 
   return {};
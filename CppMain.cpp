@@ -16,21 +16,29 @@
 
 #define LOG_TAG "sysprop_cpp"
 
+#include <android-base/file.h>
 #include <android-base/logging.h>
+#include <android-base/parseint.h>
 #include <android-base/result.h>
+#include <android-base/strings.h>
 #include <cstdio>
 #include <cstdlib>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <getopt.h>
 
+#include "Common.h"
 #include "CppGen.h"
+#include "Parallel.h"
+#include "Worker.h"
 
 using android::base::Result;
 
 namespace {
 
-struct Arguments {
+struct Job {
   std::string input_file_path;
   std::string header_dir;
   std::string public_header_dir;
@@ -38,23 +46,78 @@ struct Arguments {
   std::string include_name;
 };
 
-[[noreturn]] void PrintUsage(const char* exe_name) {
+struct Arguments {
+  std::vector<Job> jobs;
+  unsigned num_threads = 0;
+  std::string changed_outputs_path;
+};
+
+void PrintUsage(const char* exe_name) {
   std::printf(
       "Usage: %s --header-dir dir --source-dir dir "
       "--include-name name --public-header-dir dir "
-      "sysprop_file\n",
-      exe_name);
-  std::exit(EXIT_FAILURE);
+      "sysprop_file\n"
+      "       %s --header-dir dir --source-dir dir "
+      "--public-header-dir dir [--jobs n] sysprop_files...\n"
+      "       %s --manifest file [--jobs n]\n"
+      "       %s --persistent_worker [options]\n"
+      "\n"
+      "--changed-outputs file writes the paths of the outputs whose content "
+      "changed\nto file; the other outputs are left untouched.\n"
+      "With several sysprop files, the include name of each one is its base "
+      "name\nfollowed by \".h\". A sysprop file named - is read from stdin, "
+      "and its\noutputs are named after its module. Each line of a manifest "
+      "file reads\n"
+      "  sysprop_file header_dir public_header_dir source_dir include_name\n"
+      "With --persistent_worker, length-delimited work requests holding the "
+      "other\narguments are read from stdin and answered on stdout.\n",
+      exe_name, exe_name, exe_name, exe_name);
+}
+
+Result<void> ParseManifest(const std::string& manifest_path,
+                           std::vector<Job>* jobs) {
+  std::string contents;
+  if (!android::base::ReadFileToString(manifest_path, &contents, true)) {
+    return ErrnoErrorf("Error reading manifest {}", manifest_path);
+  }
+
+  std::vector<std::string> lines = android::base::Split(contents, "\n");
+  for (size_t i = 0; i < lines.size(); ++i) {
+    std::string line = android::base::Trim(lines[i]);
+    if (line.empty() || line[0] == '#') continue;
+
+    std::vector<std::string> fields;
+    for (std::string& field : android::base::Split(line, " \t")) {
+      if (!field.empty()) fields.emplace_back(std::move(field));
+    }
+
+    if (fields.size() != 5) {
+      return Errorf("{}:{}: expected 5 fields but got {}", manifest_path,
+                    i + 1, fields.size());
+    }
+
+    jobs->push_back(Job{std::move(fields[0]), std::move(fields[1]),
+                        std::move(fields[2]), std::move(fields[3]),
+                        std::move(fields[4])});
+  }
+
+  return {};
 }
 
 Result<Arguments> ParseArgs(int argc, char* argv[]) {
   Arguments ret;
+  Job common;
+  std::string manifest_path;
   for (;;) {
     static struct option long_options[] = {
         {"header-dir", required_argument, 0, 'h'},
         {"public-header-dir", required_argument, 0, 'p'},
         {"source-dir", required_argument, 0, 'c'},
         {"include-name", required_argument, 0, 'n'},
+        {"manifest", required_argument, 0, 'm'},
+        {"jobs", required_argument, 0, 'j'},
+        {"changed-outputs", required_argument, 0, 'o'},
+        {0, 0, 0, 0},
     };
 
     int opt = getopt_long_only(argc, argv, "", long_options, nullptr);
@@ -62,56 +125,176 @@ Result<Arguments> ParseArgs(int argc, char* argv[]) {
 
     switch (opt) {
       case 'h':
-        ret.header_dir = optarg;
+        common.header_dir = optarg;
         break;
       case 'p':
-        ret.public_header_dir = optarg;
+        common.public_header_dir = optarg;
         break;
       case 'c':
-        ret.source_dir = optarg;
+        common.source_dir = optarg;
         break;
       case 'n':
-        ret.include_name = optarg;
+        common.include_name = optarg;
+        break;
+      case 'm':
+        manifest_path = optarg;
+        break;
+      case 'j':
+        if (!android::base::ParseUint(optarg, &ret.num_threads)) {
+          return Errorf("Invalid number of jobs {}", optarg);
+        }
+        break;
+      case 'o':
+        ret.changed_outputs_path = optarg;
         break;
       default:
-        PrintUsage(argv[0]);
+        return Errorf("Invalid arguments");
     }
   }
 
-  if (optind >= argc) {
-    return Errorf("No input file specified");
-  }
+  if (!manifest_path.empty()) {
+    if (optind < argc) {
+      return Errorf("Input files can't be given along with a manifest");
+    }
+    if (auto res = ParseManifest(manifest_path, &ret.jobs); !res.ok()) {
+      return res.error();
+    }
+    if (ret.jobs.empty()) {
+      return Errorf("No input file specified in manifest {}", manifest_path);
+    }
+  } else {
+    if (optind >= argc) {
+      return Errorf("No input file specified");
+    }
 
-  if (optind + 1 < argc) {
-    return Errorf("More than one input file");
-  }
+    bool batch = optind + 1 < argc;
+    if (batch && !common.include_name.empty()) {
+      return Errorf("--include-name can't be used with more than one input");
+    }
 
-  if (ret.header_dir.empty() || ret.public_header_dir.empty() ||
-      ret.source_dir.empty() || ret.include_name.empty()) {
-    PrintUsage(argv[0]);
+    if (common.header_dir.empty() || common.public_header_dir.empty() ||
+        common.source_dir.empty() ||
+        (!batch && common.include_name.empty())) {
+      return Errorf("Missing output directory or include name");
+    }
+
+    // With several inputs, the empty include name makes each one include
+    // its own header.
+    for (int i = optind; i < argc; ++i) {
+      Job job = common;
+      job.input_file_path = argv[i];
+      ret.jobs.emplace_back(std::move(job));
+    }
   }
 
-  ret.input_file_path = argv[optind];
+  bool reads_stdin = false;
+  for (const Job& job : ret.jobs) {
+    if (job.input_file_path == kStdioFilePath) {
+      if (reads_stdin) return Errorf("stdin can only be read once");
+      reads_stdin = true;
+    }
+  }
 
   return ret;
 }
 
-}  // namespace
+// Generated files are named after the input, or after the module for stdin,
+// so two inputs with the same name and output dirs would overwrite each
+// other's outputs.
+Result<void> CheckOutputPaths(const std::vector<Job>& jobs,
+                              const sysprop::Properties& stdin_props) {
+  std::vector<std::string> output_paths;
+  for (const Job& job : jobs) {
+    std::vector<std::string> paths = GetCppOutputPaths(
+        GetCppOutputBasename(job.input_file_path, stdin_props),
+        job.header_dir, job.public_header_dir, job.source_dir);
+    output_paths.insert(output_paths.end(), paths.begin(), paths.end());
+  }
 
-int main(int argc, char* argv[]) {
+  return CheckDistinctOutputPaths(output_paths);
+}
+
+int Run(int argc, char* argv[]) {
   Arguments args;
   if (auto res = ParseArgs(argc, argv); res.ok()) {
     args = std::move(*res);
   } else {
     LOG(ERROR) << argv[0] << ": " << res.error();
     PrintUsage(argv[0]);
+    return EXIT_FAILURE;
   }
 
-  if (auto res = GenerateCppFiles(args.input_file_path, args.header_dir,
-                                  args.public_header_dir, args.source_dir,
-                                  args.include_name);
-      !res.ok()) {
-    LOG(FATAL) << "Error during generating cpp sysprop from "
-               << args.input_file_path << ": " << res.error();
+  // The names of the outputs generated from stdin are only known once it is
+  // parsed, so it is parsed before checking them.
+  sysprop::Properties stdin_props;
+  for (const Job& job : args.jobs) {
+    if (job.input_file_path != kStdioFilePath) continue;
+
+    if (auto res = ParseProps(kStdioFilePath); res.ok()) {
+      stdin_props = std::move(*res);
+    } else {
+      LOG(ERROR) << "Error during generating cpp sysprop from "
+                 << job.input_file_path << ": " << res.error();
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (auto res = CheckOutputPaths(args.jobs, stdin_props); !res.ok()) {
+    LOG(ERROR) << argv[0] << ": " << res.error();
+    return EXIT_FAILURE;
+  }
+
+  std::vector<Result<void>> results(args.jobs.size());
+  std::vector<std::vector<std::string>> changed_outputs(args.jobs.size());
+  ParallelFor(args.jobs.size(), args.num_threads, [&](size_t i) {
+    const Job& job = args.jobs[i];
+    if (job.input_file_path == kStdioFilePath) {
+      std::string basename = GetCppOutputBasename(kStdioFilePath, stdin_props);
+      results[i] = GenerateCppFiles(
+          stdin_props, basename, job.header_dir, job.public_header_dir,
+          job.source_dir,
+          job.include_name.empty() ? basename + ".h" : job.include_name,
+          &changed_outputs[i]);
+      return;
+    }
+
+    results[i] = GenerateCppFiles(job.input_file_path, job.header_dir,
+                                  job.public_header_dir, job.source_dir,
+                                  job.include_name, &changed_outputs[i]);
+  });
+
+  // Report errors in input order regardless of which job finished first.
+  bool failed = false;
+  for (size_t i = 0; i < results.size(); ++i) {
+    if (!results[i].ok()) {
+      LOG(ERROR) << "Error during generating cpp sysprop from "
+                 << args.jobs[i].input_file_path << ": " << results[i].error();
+      failed = true;
+    }
+  }
+
+  if (!args.changed_outputs_path.empty()) {
+    std::vector<std::string> all_changed_outputs;
+    for (const auto& outputs : changed_outputs) {
+      all_changed_outputs.insert(all_changed_outputs.end(), outputs.begin(),
+                                 outputs.end());
+    }
+    if (auto res = WriteChangedOutputsFile(all_changed_outputs,
+                                           args.changed_outputs_path);
+        !res.ok()) {
+      LOG(ERROR) << res.error();
+      failed = true;
+    }
+  }
+
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (IsPersistentWorker(argc, argv)) {
+    return RunPersistentWorker(argc, argv, Run);
   }
+  return Run(argc, argv);
 }
@@ -0,0 +1,359 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#define LOG_TAG "sysprop_gen"
+
+#include <android-base/file.h>
+#include <android-base/logging.h>
+#include <android-base/parseint.h>
+#include <android-base/result.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <getopt.h>
+
+#include "ApiDump.h"
+#include "Common.h"
+#include "CppGen.h"
+#include "JavaGen.h"
+#include "Parallel.h"
+#include "Worker.h"
+#include "sysprop.pb.h"
+
+using android::base::Result;
+
+namespace {
+
+struct JavaOutput {
+  sysprop::Scope scope;
+  std::string java_output_dir;
+};
+
+struct Arguments {
+  std::vector<std::string> input_file_paths;
+
+  std::string cpp_header_dir;
+  std::string cpp_public_header_dir;
+  std::string cpp_source_dir;
+  std::string cpp_include_name;
+
+  std::vector<JavaOutput> java_outputs;
+  JavaGenOptions java_options;
+
+  std::string api_dump_file_path;
+
+  unsigned num_threads = 0;
+  std::string changed_outputs_path;
+};
+
+void PrintUsage(const char* exe_name) {
+  std::printf(
+      "Usage: %s [C++ options] [Java options] [--api-dump file] [--jobs n] "
+      "[--changed-outputs file] sysprop_files...\n"
+      "       %s --persistent_worker [options]\n"
+      "\n"
+      "Parses and validates each sysprop file once, then generates the "
+      "requested outputs.\n"
+      "\n"
+      "C++ options (all three dirs enable C++ generation):\n"
+      "  --cpp-header-dir dir --cpp-public-header-dir dir --cpp-source-dir "
+      "dir\n"
+      "  [--cpp-include-name name]  only with a single sysprop file; "
+      "defaults to the\n"
+      "                             file's base name followed by \".h\"\n"
+      "\n"
+      "Java options (may be repeated, the n-th dir belongs to the n-th "
+      "scope):\n"
+      "  --java-scope (internal|public) --java-output-dir dir\n"
+      "  [--java-lambda-free] [--java-primitive-arrays] "
+      "[--java-change-callbacks]\n"
+      "  [--java-snapshot]\n"
+      "\n"
+      "API dump options:\n"
+      "  --api-dump file            writes the API of all sysprop files, as "
+      "sysprop_api_dump\n"
+      "                             (- for stdout)\n"
+      "\n"
+      "A sysprop file named - is read from stdin, and its C++ outputs are "
+      "named after\nits module.\n"
+      "\n"
+      "Outputs whose content is unchanged are left untouched. "
+      "--changed-outputs file\nwrites the paths of the other ones to file.\n"
+      "\n"
+      "With --persistent_worker, length-delimited work requests holding the "
+      "other\narguments are read from stdin and answered on stdout.\n",
+      exe_name, exe_name);
+}
+
+Result<Arguments> ParseArgs(int argc, char* argv[]) {
+  Arguments ret;
+  std::vector<sysprop::Scope> java_scopes;
+  std::vector<std::string> java_output_dirs;
+  for (;;) {
+    static struct option long_options[] = {
+        {"cpp-header-dir", required_argument, 0, 'h'},
+        {"cpp-public-header-dir", required_argument, 0, 'p'},
+        {"cpp-source-dir", required_argument, 0, 'c'},
+        {"cpp-include-name", required_argument, 0, 'n'},
+        {"java-scope", required_argument, 0, 's'},
+        {"java-output-dir", required_argument, 0, 'o'},
+        {"java-lambda-free", no_argument, 0, 'l'},
+        {"java-primitive-arrays", no_argument, 0, 'a'},
+        {"java-change-callbacks", no_argument, 0, 'b'},
+        {"java-snapshot", no_argument, 0, 'S'},
+        {"api-dump", required_argument, 0, 'd'},
+        {"jobs", required_argument, 0, 'j'},
+        {"changed-outputs", required_argument, 0, 'C'},
+        {0, 0, 0, 0},
+    };
+
+    int opt = getopt_long_only(argc, argv, "", long_options, nullptr);
+    if (opt == -1) break;
+
+    switch (opt) {
+      case 'h':
+        ret.cpp_header_dir = optarg;
+        break;
+      case 'p':
+        ret.cpp_public_header_dir = optarg;
+        break;
+      case 'c':
+        ret.cpp_source_dir = optarg;
+        break;
+      case 'n':
+        ret.cpp_include_name = optarg;
+        break;
+      case 's':
+        if (strcmp(optarg, "public") == 0) {
+          java_scopes.push_back(sysprop::Scope::Public);
+        } else if (strcmp(optarg, "internal") == 0) {
+          java_scopes.push_back(sysprop::Scope::Internal);
+        } else {
+          return Errorf("Invalid option {} for scope", optarg);
+        }
+        break;
+      case 'o':
+        java_output_dirs.emplace_back(optarg);
+        break;
+      case 'l':
+        ret.java_options.lambda_free = true;
+        break;
+      case 'a':
+        ret.java_options.primitive_arrays = true;
+        break;
+      case 'b':
+        ret.java_options.change_callbacks = true;
+        break;
+      case 'S':
+        ret.java_options.snapshot = true;
+        break;
+      case 'd':
+        ret.api_dump_file_path = optarg;
+        break;
+      case 'j':
+        if (!android::base::ParseUint(optarg, &ret.num_threads)) {
+          return Errorf("Invalid number of jobs {}", optarg);
+        }
+        break;
+      case 'C':
+        ret.changed_outputs_path = optarg;
+        break;
+      default:
+        return Errorf("Invalid arguments");
+    }
+  }
+
+  if (optind >= argc) {
+    return Errorf("No input file specified");
+  }
+
+  ret.input_file_paths.assign(argv + optind, argv + argc);
+
+  std::set<std::string> unique_paths(ret.input_file_paths.begin(),
+                                     ret.input_file_paths.end());
+  if (unique_paths.size() != ret.input_file_paths.size()) {
+    return Errorf("The same input file is given more than once");
+  }
+
+  bool cpp = !ret.cpp_header_dir.empty() ||
+             !ret.cpp_public_header_dir.empty() ||
+             !ret.cpp_source_dir.empty() || !ret.cpp_include_name.empty();
+  if (cpp) {
+    if (ret.cpp_header_dir.empty() || ret.cpp_public_header_dir.empty() ||
+        ret.cpp_source_dir.empty()) {
+      return Errorf(
+          "--cpp-header-dir, --cpp-public-header-dir and --cpp-source-dir "
+          "must be given together");
+    }
+    if (!ret.cpp_include_name.empty() && ret.input_file_paths.size() > 1) {
+      return Errorf(
+          "--cpp-include-name can't be used with more than one input");
+    }
+
+    std::set<std::string> basenames;
+    for (const std::string& path : ret.input_file_paths) {
+      if (path == kStdioFilePath) continue;
+      if (!basenames.insert(android::base::Basename(path)).second) {
+        return Errorf("More than one input generates C++ files for {}",
+                      android::base::Basename(path));
+      }
+    }
+  }
+
+  if (java_output_dirs.size() != java_scopes.size()) {
+    return Errorf("Got {} --java-scope but {} --java-output-dir",
+                  java_scopes.size(), java_output_dirs.size());
+  }
+  for (size_t i = 0; i < java_scopes.size(); ++i) {
+    ret.java_outputs.push_back(JavaOutput{java_scopes[i], java_output_dirs[i]});
+  }
+
+  if (!cpp && ret.java_outputs.empty() && ret.api_dump_file_path.empty()) {
+    return Errorf("No output requested");
+  }
+
+  return ret;
+}
+
+Result<void> GenerateOutputs(const std::string& input_file_path,
+                             const sysprop::Properties& props,
+                             const Arguments& args,
+                             std::vector<std::string>* changed_outputs) {
+  if (!args.cpp_header_dir.empty()) {
+    std::string basename = GetCppOutputBasename(input_file_path, props);
+    std::string include_name = args.cpp_include_name.empty()
+                                   ? basename + ".h"
+                                   : args.cpp_include_name;
+    if (auto res = GenerateCppFiles(props, basename, args.cpp_header_dir,
+                                    args.cpp_public_header_dir,
+                                    args.cpp_source_dir, include_name,
+                                    changed_outputs);
+        !res.ok()) {
+      return Errorf("Error during generating cpp sysprop: {}",
+                    res.error().message());
+    }
+  }
+
+  for (const JavaOutput& output : args.java_outputs) {
+    if (auto res = GenerateJavaLibrary(props, output.scope,
+                                       output.java_output_dir,
+                                       args.java_options, changed_outputs);
+        !res.ok()) {
+      return Errorf("Error during generating java sysprop: {}",
+                    res.error().message());
+    }
+  }
+
+  return {};
+}
+
+int Run(int argc, char* argv[]) {
+  Arguments args;
+  if (auto res = ParseArgs(argc, argv); res.ok()) {
+    args = std::move(*res);
+  } else {
+    LOG(ERROR) << argv[0] << ": " << res.error();
+    PrintUsage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  const std::vector<std::string>& inputs = args.input_file_paths;
+  std::vector<sysprop::Properties> modules(inputs.size());
+  std::vector<Result<void>> results(inputs.size());
+  std::vector<std::vector<std::string>> changed_outputs(inputs.size());
+
+  // Report errors in input order regardless of which job finished first.
+  auto report_errors = [&] {
+    bool failed = false;
+    for (size_t i = 0; i < results.size(); ++i) {
+      if (!results[i].ok()) {
+        LOG(ERROR) << inputs[i] << ": " << results[i].error();
+        failed = true;
+      }
+    }
+    return failed;
+  };
+
+  ParallelFor(inputs.size(), args.num_threads, [&](size_t i) {
+    if (auto res = ParseProps(inputs[i]); res.ok()) {
+      modules[i] = std::move(*res);
+    } else {
+      results[i] = Errorf("parsing sysprop file failed: {}",
+                          res.error().message());
+    }
+  });
+  if (report_errors()) return EXIT_FAILURE;
+
+  // Java classes are named after the module, which only parsing reveals; two
+  // inputs with the same module would race writing the same file.
+  std::vector<std::string> java_output_paths;
+  for (const sysprop::Properties& props : modules) {
+    for (const JavaOutput& output : args.java_outputs) {
+      java_output_paths.push_back(
+          GetJavaOutputPath(props, output.java_output_dir));
+    }
+  }
+  if (auto res = CheckDistinctOutputPaths(java_output_paths); !res.ok()) {
+    LOG(ERROR) << res.error();
+    return EXIT_FAILURE;
+  }
+
+  ParallelFor(inputs.size(), args.num_threads, [&](size_t i) {
+    results[i] =
+        GenerateOutputs(inputs[i], modules[i], args, &changed_outputs[i]);
+  });
+  if (report_errors()) return EXIT_FAILURE;
+
+  std::vector<std::string> all_changed_outputs;
+  for (const auto& outputs : changed_outputs) {
+    all_changed_outputs.insert(all_changed_outputs.end(), outputs.begin(),
+                               outputs.end());
+  }
+
+  if (!args.api_dump_file_path.empty()) {
+    if (auto res = DumpApis(std::move(modules), args.api_dump_file_path,
+                            &all_changed_outputs);
+        !res.ok()) {
+      LOG(ERROR) << res.error();
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (!args.changed_outputs_path.empty()) {
+    if (auto res = WriteChangedOutputsFile(all_changed_outputs,
+                                           args.changed_outputs_path);
+        !res.ok()) {
+      LOG(ERROR) << res.error();
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (IsPersistentWorker(argc, argv)) {
+    return RunPersistentWorker(argc, argv, Run);
+  }
+  return Run(argc, argv);
+}
@@ -22,13 +22,18 @@
 #include <android-base/logging.h>
 #include <android-base/stringprintf.h>
 #include <android-base/strings.h>
+#include <algorithm>
 #include <cerrno>
 #include <filesystem>
-#include <regex>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "CodeWriter.h"
 #include "Common.h"
+#include "ResolvedProps.h"
 #include "sysprop.pb.h"
 
 using android::base::Result;
@@ -37,21 +42,13 @@ namespace {
 
 constexpr const char* kIndent = "    ";
 
-constexpr const char* kJavaFileImports =
-    R"(import android.os.SystemProperties;
+// Rough sizes of the generated code per prop, used to reserve the output.
+constexpr size_t kJavaBytesPerProp = 384;
+constexpr size_t kJavaCallbackBytesPerProp = 2560;
+constexpr size_t kJavaSupportCodeBytes = 16384;
 
-import java.lang.StringBuilder;
-import java.util.ArrayList;
-import java.util.function.Function;
-import java.util.List;
-import java.util.Locale;
-import java.util.Optional;
-import java.util.StringJoiner;
-import java.util.stream.Collectors;
 
-)";
-
-constexpr const char* kJavaParsersAndFormatters =
+constexpr std::string_view kJavaScalarParsers =
     R"s(private static Boolean tryParseBoolean(String str) {
     switch (str.toLowerCase(Locale.US)) {
         case "1":
@@ -100,7 +97,10 @@ private static <T extends Enum<T>> T tryParseEnum(Class<T> enumType, String str)
         return null;
     }
 }
+)s";
 
+constexpr std::string_view kJavaListParsersAndFormatters =
+    R"s(
 private static <T> List<T> tryParseList(Function<String, T> elementParser, String str) {
     if ("".equals(str)) return new ArrayList<>();
 
@@ -159,24 +159,353 @@ private static <T extends Enum<T>> String formatEnumList(List<T> list, Function<
 }
 )s";
 
-const std::regex kRegexDot{"\\."};
-const std::regex kRegexUnderscore{"_"};
+// Scanning helpers shared by the lambda-free list parsers and the
+// primitive-array parsers, which both parse list elements in place instead of
+// splitting the string into a list of elements first.
+constexpr std::string_view kJavaListElementScanners =
+    R"s(
+private static int findListElementEnd(String str, int p) {
+    while (p < str.length() && str.charAt(p) != ',') {
+        if (str.charAt(p) == '\\') ++p;
+        ++p;
+    }
+    return Math.min(p, str.length());
+}
+
+private static String getListElement(String str, int begin, int end) {
+    String element = str.substring(begin, end);
+    if (element.indexOf('\\') < 0) return element;
 
-std::string GetJavaTypeName(const sysprop::Property& prop);
-std::string GetJavaEnumTypeName(const sysprop::Property& prop);
-std::string GetJavaPackageName(const sysprop::Properties& props);
-std::string GetJavaClassName(const sysprop::Properties& props);
-std::string GetParsingExpression(const sysprop::Property& prop);
-std::string GetFormattingExpression(const sysprop::Property& prop);
-std::string GenerateJavaClass(const sysprop::Properties& props,
-                              sysprop::Scope scope);
+    StringBuilder sb = new StringBuilder(element.length());
+    for (int p = 0; p < element.length(); ++p) {
+        if (element.charAt(p) == '\\' && ++p == element.length()) break;
+        sb.append(element.charAt(p));
+    }
+    return sb.toString();
+}
+)s";
+
+// List helpers for JavaGenOptions::lambda_free. Every list type gets its own
+// static parser so that no Function objects (and hence no lambda metafactory
+// bootstrap) are needed, and escaping is done without java.util.regex.
+constexpr std::string_view kJavaLambdaFreeListParsersAndFormatters =
+    R"s(
+private static List<Boolean> tryParseBooleanList(String str) {
+    List<Boolean> ret = new ArrayList<>();
+    if ("".equals(str)) return ret;
+
+    int p = 0;
+    for (;;) {
+        int end = findListElementEnd(str, p);
+        ret.add(tryParseBoolean(getListElement(str, p, end)));
+        if (end == str.length()) break;
+        p = end + 1;
+    }
 
-std::string GetJavaEnumTypeName(const sysprop::Property& prop) {
-  return ApiNameToIdentifier(prop.api_name()) + "_values";
+    return ret;
 }
 
-std::string GetJavaTypeName(const sysprop::Property& prop) {
-  switch (prop.type()) {
+private static List<Integer> tryParseIntegerList(String str) {
+    List<Integer> ret = new ArrayList<>();
+    if ("".equals(str)) return ret;
+
+    int p = 0;
+    for (;;) {
+        int end = findListElementEnd(str, p);
+        ret.add(tryParseInteger(getListElement(str, p, end)));
+        if (end == str.length()) break;
+        p = end + 1;
+    }
+
+    return ret;
+}
+
+private static List<Long> tryParseLongList(String str) {
+    List<Long> ret = new ArrayList<>();
+    if ("".equals(str)) return ret;
+
+    int p = 0;
+    for (;;) {
+        int end = findListElementEnd(str, p);
+        ret.add(tryParseLong(getListElement(str, p, end)));
+        if (end == str.length()) break;
+        p = end + 1;
+    }
+
+    return ret;
+}
+
+private static List<Double> tryParseDoubleList(String str) {
+    List<Double> ret = new ArrayList<>();
+    if ("".equals(str)) return ret;
+
+    int p = 0;
+    for (;;) {
+        int end = findListElementEnd(str, p);
+        ret.add(tryParseDouble(getListElement(str, p, end)));
+        if (end == str.length()) break;
+        p = end + 1;
+    }
+
+    return ret;
+}
+
+private static List<String> tryParseStringList(String str) {
+    List<String> ret = new ArrayList<>();
+    if ("".equals(str)) return ret;
+
+    int p = 0;
+    for (;;) {
+        int end = findListElementEnd(str, p);
+        ret.add(tryParseString(getListElement(str, p, end)));
+        if (end == str.length()) break;
+        p = end + 1;
+    }
+
+    return ret;
+}
+
+private static <T extends Enum<T>> List<T> tryParseEnumList(Class<T> enumType, String str) {
+    if ("".equals(str)) return new ArrayList<>();
+
+    List<T> ret = new ArrayList<>();
+
+    for (String element : str.split(",")) {
+        ret.add(tryParseEnum(enumType, element));
+    }
+
+    return ret;
+}
+
+private static String escape(String str) {
+    if (str.indexOf('\\') < 0 && str.indexOf(',') < 0) return str;
+
+    StringBuilder sb = new StringBuilder(str.length() + 8);
+    for (int i = 0; i < str.length(); ++i) {
+        char c = str.charAt(i);
+        if (c == '\\' || c == ',') sb.append('\\');
+        sb.append(c);
+    }
+    return sb.toString();
+}
+
+private static <T> String formatList(List<T> list) {
+    StringJoiner joiner = new StringJoiner(",");
+
+    for (T element : list) {
+        joiner.add(element == null ? "" : escape(element.toString()));
+    }
+
+    return joiner.toString();
+}
+
+private static String formatIntegerAsBoolList(List<Boolean> list) {
+    StringJoiner joiner = new StringJoiner(",");
+
+    for (Boolean element : list) {
+        joiner.add(element == null ? "" : (element ? "1" : "0"));
+    }
+
+    return joiner.toString();
+}
+)s";
+
+// Helpers for JavaGenOptions::primitive_arrays. They parse list props straight
+// into primitive arrays without boxing each element; elements that fail to
+// parse are left as 0 / false and cleared in the optional validity mask.
+constexpr std::string_view kJavaPrimitiveArrayParsersAndFormatters =
+    R"s(
+private static int countListElements(String str) {
+    if ("".equals(str)) return 0;
+
+    int n = 1;
+    for (int p = 0; p < str.length(); ++p) {
+        char c = str.charAt(p);
+        if (c == '\\') {
+            ++p;
+        } else if (c == ',') {
+            ++n;
+        }
+    }
+    return n;
+}
+
+private static boolean[] tryParseBooleanArray(String str, BitSet valid) {
+    boolean[] ret = new boolean[countListElements(str)];
+    if (valid != null) valid.clear();
+
+    int p = 0;
+    for (int i = 0; i < ret.length; ++i) {
+        int end = findListElementEnd(str, p);
+        String element = getListElement(str, p, end);
+        if ("1".equals(element) || "true".equalsIgnoreCase(element)) {
+            ret[i] = true;
+            if (valid != null) valid.set(i);
+        } else if ("0".equals(element) || "false".equalsIgnoreCase(element)) {
+            if (valid != null) valid.set(i);
+        }
+        p = end + 1;
+    }
+
+    return ret;
+}
+
+private static int[] tryParseIntegerArray(String str, BitSet valid) {
+    int[] ret = new int[countListElements(str)];
+    if (valid != null) valid.clear();
+
+    int p = 0;
+    for (int i = 0; i < ret.length; ++i) {
+        int end = findListElementEnd(str, p);
+        try {
+            ret[i] = Integer.parseInt(getListElement(str, p, end));
+            if (valid != null) valid.set(i);
+        } catch (NumberFormatException e) {
+        }
+        p = end + 1;
+    }
+
+    return ret;
+}
+
+private static long[] tryParseLongArray(String str, BitSet valid) {
+    long[] ret = new long[countListElements(str)];
+    if (valid != null) valid.clear();
+
+    int p = 0;
+    for (int i = 0; i < ret.length; ++i) {
+        int end = findListElementEnd(str, p);
+        try {
+            ret[i] = Long.parseLong(getListElement(str, p, end));
+            if (valid != null) valid.set(i);
+        } catch (NumberFormatException e) {
+        }
+        p = end + 1;
+    }
+
+    return ret;
+}
+
+private static double[] tryParseDoubleArray(String str, BitSet valid) {
+    double[] ret = new double[countListElements(str)];
+    if (valid != null) valid.clear();
+
+    int p = 0;
+    for (int i = 0; i < ret.length; ++i) {
+        int end = findListElementEnd(str, p);
+        try {
+            ret[i] = Double.parseDouble(getListElement(str, p, end));
+            if (valid != null) valid.set(i);
+        } catch (NumberFormatException e) {
+        }
+        p = end + 1;
+    }
+
+    return ret;
+}
+
+private static String formatArray(boolean[] array) {
+    StringBuilder sb = new StringBuilder();
+    for (int i = 0; i < array.length; ++i) {
+        if (i > 0) sb.append(',');
+        sb.append(array[i]);
+    }
+    return sb.toString();
+}
+
+private static String formatIntegerAsBoolArray(boolean[] array) {
+    StringBuilder sb = new StringBuilder();
+    for (int i = 0; i < array.length; ++i) {
+        if (i > 0) sb.append(',');
+        sb.append(array[i] ? '1' : '0');
+    }
+    return sb.toString();
+}
+
+private static String formatArray(int[] array) {
+    StringBuilder sb = new StringBuilder();
+    for (int i = 0; i < array.length; ++i) {
+        if (i > 0) sb.append(',');
+        sb.append(array[i]);
+    }
+    return sb.toString();
+}
+
+private static String formatArray(long[] array) {
+    StringBuilder sb = new StringBuilder();
+    for (int i = 0; i < array.length; ++i) {
+        if (i > 0) sb.append(',');
+        sb.append(array[i]);
+    }
+    return sb.toString();
+}
+
+private static String formatArray(double[] array) {
+    StringBuilder sb = new StringBuilder();
+    for (int i = 0; i < array.length; ++i) {
+        if (i > 0) sb.append(',');
+        sb.append(array[i]);
+    }
+    return sb.toString();
+}
+)s";
+
+// Shared plumbing for JavaGenOptions::change_callbacks and ::snapshot. A
+// single Runnable is registered with SystemProperties per generated class,
+// the first time either feature is used; it calls onSystemPropertiesChanged(),
+// which is emitted at the end of the class.
+constexpr std::string_view kJavaChangeListenerSupport =
+    R"s(
+private static final Object sChangeCallbackLock = new Object();
+private static boolean sChangeCallbackRegistered = false;
+
+private static void registerChangeCallbackLocked() {
+    if (sChangeCallbackRegistered) return;
+    sChangeCallbackRegistered = true;
+    SystemProperties.addChangeCallback(new Runnable() {
+        @Override
+        public void run() {
+            onSystemPropertiesChanged();
+        }
+    });
+}
+)s";
+
+// On every change, the per-prop dispatchers re-read only the props that have
+// callbacks and notify them if the parsed value differs from the one seen
+// last time.
+constexpr std::string_view kJavaChangeCallbackInterface =
+    R"s(
+// Callbacks may run on the thread reporting system property changes, with
+// no lock held. A prop's values are delivered one at a time, in the order
+// they were read.
+public interface ChangeCallback<T> {
+    void onChange(T value);
+}
+)s";
+
+// snapshot() re-reads everything if a change notification arrived while it
+// was reading, up to SNAPSHOT_MAX_ATTEMPTS times, and returns the last read
+// either way. Notifications are asynchronous, so this is best effort: a change
+// made while reading is usually reported too late to be noticed.
+constexpr std::string_view kJavaSnapshotSupport =
+    R"s(
+private static final int SNAPSHOT_MAX_ATTEMPTS = 3;
+private static volatile int sChangeCount = 0;
+)s";
+
+std::string GetJavaTypeName(const ResolvedProperty& prop);
+std::string GetJavaValueTypeName(const ResolvedProperty& prop);
+std::string GetJavaPrimitiveArrayTypeName(const ResolvedProperty& prop);
+std::string GetJavaPackageName(const sysprop::Properties& props);
+std::string GetJavaClassName(const sysprop::Properties& props);
+std::string GetParsingExpression(const ResolvedProperty& prop,
+                                 const JavaGenOptions& options);
+std::string GetFormattingExpression(const ResolvedProperty& prop,
+                                    const JavaGenOptions& options);
+
+std::string GetJavaTypeName(const ResolvedProperty& prop) {
+  switch (prop.type) {
     case sysprop::Boolean:
       return "Boolean";
     case sysprop::Integer:
@@ -188,7 +517,7 @@ std::string GetJavaTypeName(const sysprop::Property& prop) {
     case sysprop::String:
       return "String";
     case sysprop::Enum:
-      return GetJavaEnumTypeName(prop);
+      return prop.enum_type_name;
     case sysprop::BooleanList:
       return "List<Boolean>";
     case sysprop::IntegerList:
@@ -200,14 +529,57 @@ std::string GetJavaTypeName(const sysprop::Property& prop) {
     case sysprop::StringList:
       return "List<String>";
     case sysprop::EnumList:
-      return "List<" + GetJavaEnumTypeName(prop) + ">";
+      return "List<" + prop.enum_type_name + ">";
+    default:
+      __builtin_unreachable();
+  }
+}
+
+std::string GetLambdaFreeEnumListFormatterName(const ResolvedProperty& prop) {
+  return "formatList_" + prop.enum_type_name;
+}
+
+// Type returned by the getter: List<T> for lists and Optional<T> otherwise.
+std::string GetJavaValueTypeName(const ResolvedProperty& prop) {
+  if (prop.is_list) return GetJavaTypeName(prop);
+  return "Optional<" + GetJavaTypeName(prop) + ">";
+}
+
+// Returns e.g. "int[]" for list props that have a primitive-array accessor,
+// or an empty string for those that don't.
+std::string GetJavaPrimitiveArrayTypeName(const ResolvedProperty& prop) {
+  switch (prop.type) {
+    case sysprop::BooleanList:
+      return "boolean[]";
+    case sysprop::IntegerList:
+      return "int[]";
+    case sysprop::LongList:
+      return "long[]";
+    case sysprop::DoubleList:
+      return "double[]";
+    default:
+      return "";
+  }
+}
+
+std::string GetArrayParsingFunctionName(const ResolvedProperty& prop) {
+  switch (prop.type) {
+    case sysprop::BooleanList:
+      return "tryParseBooleanArray";
+    case sysprop::IntegerList:
+      return "tryParseIntegerArray";
+    case sysprop::LongList:
+      return "tryParseLongArray";
+    case sysprop::DoubleList:
+      return "tryParseDoubleArray";
     default:
       __builtin_unreachable();
   }
 }
 
-std::string GetParsingExpression(const sysprop::Property& prop) {
-  switch (prop.type()) {
+std::string GetParsingExpression(const ResolvedProperty& prop,
+                                 const JavaGenOptions& options) {
+  switch (prop.type) {
     case sysprop::Boolean:
       return "tryParseBoolean(value)";
     case sysprop::Integer:
@@ -219,20 +591,37 @@ std::string GetParsingExpression(const sysprop::Property& prop) {
     case sysprop::String:
       return "tryParseString(value)";
     case sysprop::Enum:
-      return "tryParseEnum(" + GetJavaEnumTypeName(prop) + ".class, value)";
+      return "tryParseEnum(" + prop.enum_type_name + ".class, value)";
     case sysprop::EnumList:
-      return "tryParseEnumList(" + GetJavaEnumTypeName(prop) +
+      return "tryParseEnumList(" + prop.enum_type_name +
              ".class, "
              "value)";
     default:
       break;
   }
 
+  if (options.lambda_free) {
+    switch (prop.type) {
+      case sysprop::BooleanList:
+        return "tryParseBooleanList(value)";
+      case sysprop::IntegerList:
+        return "tryParseIntegerList(value)";
+      case sysprop::LongList:
+        return "tryParseLongList(value)";
+      case sysprop::DoubleList:
+        return "tryParseDoubleList(value)";
+      case sysprop::StringList:
+        return "tryParseStringList(value)";
+      default:
+        __builtin_unreachable();
+    }
+  }
+
   // The remaining cases are lists for types other than Enum which share the
   // same parsing function "tryParseList"
   std::string element_parser;
 
-  switch (prop.type()) {
+  switch (prop.type) {
     case sysprop::BooleanList:
       element_parser = "v -> tryParseBoolean(v)";
       break;
@@ -255,29 +644,117 @@ std::string GetParsingExpression(const sysprop::Property& prop) {
   return "tryParseList(" + element_parser + ", value)";
 }
 
-std::string GetFormattingExpression(const sysprop::Property& prop) {
-  if (prop.integer_as_bool()) {
-    if (prop.type() == sysprop::Boolean) {
+std::string GetFormattingExpression(const ResolvedProperty& prop,
+                                    const JavaGenOptions& options) {
+  if (prop.prop->integer_as_bool()) {
+    if (prop.type == sysprop::Boolean) {
       // Boolean -> Integer String
       return "(value ? \"1\" : \"0\")";
+    } else if (options.lambda_free) {
+      return "formatIntegerAsBoolList(value)";
     } else {
       // List<Boolean> -> String directly
       return "value.stream().map("
              "x -> x == null ? \"\" : (x ? \"1\" : \"0\"))"
              ".collect(Collectors.joining(\",\"))";
     }
-  } else if (prop.type() == sysprop::Enum) {
+  } else if (prop.type == sysprop::Enum) {
     return "value.getPropValue()";
-  } else if (prop.type() == sysprop::EnumList) {
-    return "formatEnumList(value, " + GetJavaEnumTypeName(prop) +
+  } else if (prop.type == sysprop::EnumList) {
+    if (options.lambda_free) {
+      return GetLambdaFreeEnumListFormatterName(prop) + "(value)";
+    }
+    return "formatEnumList(value, " + prop.enum_type_name +
            "::getPropValue)";
-  } else if (IsListProp(prop)) {
+  } else if (prop.is_list) {
     return "formatList(value)";
   } else {
     return "value.toString()";
   }
 }
 
+// Writes the imports of the generated class. The lambda-free helpers never
+// touch java.util.function and java.util.stream.
+void WriteJavaImports(const JavaGenOptions& options, CodeWriter* writer) {
+  writer->Write("import android.os.SystemProperties;\n\n");
+  writer->Write("import java.lang.StringBuilder;\n");
+  if (options.change_callbacks) {
+    writer->Write("import java.util.ArrayDeque;\n");
+  }
+  writer->Write("import java.util.ArrayList;\n");
+  if (options.primitive_arrays) {
+    writer->Write("import java.util.BitSet;\n");
+  }
+  if (!options.lambda_free) {
+    writer->Write("import java.util.function.Function;\n");
+  }
+  writer->Write("import java.util.List;\n");
+  writer->Write("import java.util.Locale;\n");
+  writer->Write("import java.util.Optional;\n");
+  writer->Write("import java.util.StringJoiner;\n");
+  if (!options.lambda_free) {
+    writer->Write("import java.util.stream.Collectors;\n");
+  }
+  writer->Write("\n");
+}
+
+// Suffixes of the members JavaGenOptions::change_callbacks adds for a prop.
+constexpr const char* kChangeCallbackMemberSuffixes[] = {
+    "_changeCallbacks",     "_lastValue",         "_pendingValues",
+    "_dispatching",         "_addChangeCallback", "_removeChangeCallback",
+    "_dispatchChange",
+};
+
+// Some members are named after a prop plus a suffix, e.g. the
+// <prop>_array() accessors, and may clash with the members of another prop.
+// Returns an error naming the first clash, which javac would reject.
+Result<void> CheckJavaMemberNames(const ResolvedProps& resolved,
+                                  sysprop::Scope scope,
+                                  const JavaGenOptions& options) {
+  // Member name -> description of what it is generated for.
+  std::unordered_map<std::string, std::string> members;
+  auto add_member = [&](std::string name,
+                        const std::string& owner) -> Result<void> {
+    auto it = members.find(name);
+    if (it != members.end()) {
+      return Errorf("{} generated for {} clashes with the one generated for {}",
+                    name, owner, it->second);
+    }
+    members.emplace(std::move(name), owner);
+    return {};
+  };
+
+  if (options.snapshot) {
+    if (auto res = add_member("snapshot", "the snapshot() factory");
+        !res.ok()) {
+      return res;
+    }
+  }
+
+  for (const ResolvedProperty& prop : resolved.properties) {
+    if (prop.scope > scope) continue;
+
+    std::string owner = "prop " + prop.prop->api_name();
+    std::vector<std::string> names = {prop.identifier};
+    if (options.primitive_arrays &&
+        !GetJavaPrimitiveArrayTypeName(prop).empty()) {
+      names.push_back(prop.identifier + "_array");
+    }
+    if (options.change_callbacks) {
+      for (const char* suffix : kChangeCallbackMemberSuffixes) {
+        names.push_back(prop.identifier + suffix);
+      }
+    }
+    for (std::string& name : names) {
+      if (auto res = add_member(std::move(name), owner); !res.ok()) {
+        return res;
+      }
+    }
+  }
+
+  return {};
+}
+
 std::string GetJavaPackageName(const sysprop::Properties& props) {
   const std::string& module = props.module();
   return module.substr(0, module.rfind('.'));
@@ -288,40 +765,68 @@ std::string GetJavaClassName(const sysprop::Properties& props) {
   return module.substr(module.rfind('.') + 1);
 }
 
-std::string GenerateJavaClass(const sysprop::Properties& props,
-                              sysprop::Scope scope) {
+// Same as GenerateJavaClass(), for props whose member names were checked with
+// CheckJavaMemberNames().
+void WriteJavaClass(const ResolvedProps& resolved, sysprop::Scope scope,
+                    const JavaGenOptions& options, CodeSink* sink) {
+  const sysprop::Properties& props = *resolved.props;
   std::string package_name = GetJavaPackageName(props);
   std::string class_name = GetJavaClassName(props);
 
-  CodeWriter writer(kIndent);
-  writer.Write("%s", kGeneratedFileFooterComments);
+  CodeWriter writer(kIndent, sink);
+  writer.Reserve(kJavaSupportCodeBytes +
+                 resolved.properties.size() *
+                     (kJavaBytesPerProp + (options.change_callbacks
+                                               ? kJavaCallbackBytesPerProp
+                                               : 0)));
+  writer.Write(std::string_view(kGeneratedFileFooterComments));
   writer.Write("package %s;\n\n", package_name.c_str());
-  writer.Write("%s", kJavaFileImports);
+  WriteJavaImports(options, &writer);
   writer.Write("public final class %s {\n", class_name.c_str());
   writer.Indent();
   writer.Write("private %s () {}\n\n", class_name.c_str());
-  writer.Write("%s", kJavaParsersAndFormatters);
+  writer.Write(kJavaScalarParsers);
+  if (options.lambda_free || options.primitive_arrays) {
+    writer.Write(kJavaListElementScanners);
+  }
+  writer.Write(options.lambda_free ? kJavaLambdaFreeListParsersAndFormatters
+                                   : kJavaListParsersAndFormatters);
+  if (options.primitive_arrays) {
+    writer.Write(kJavaPrimitiveArrayParsersAndFormatters);
+  }
+  if (options.change_callbacks || options.snapshot) {
+    writer.Write(kJavaChangeListenerSupport);
+  }
+  if (options.change_callbacks) {
+    writer.Write(kJavaChangeCallbackInterface);
+  }
+  if (options.snapshot) {
+    writer.Write(kJavaSnapshotSupport);
+  }
+
+  // Props visible in this scope, in declaration order.
+  std::vector<const ResolvedProperty*> visible_props;
 
-  for (int i = 0; i < props.prop_size(); ++i) {
-    const sysprop::Property& prop = props.prop(i);
+  std::vector<std::string> dispatchers;
 
+  for (const ResolvedProperty& prop : resolved.properties) {
     // skip if scope is internal and we are generating public class
-    if (prop.scope() > scope) continue;
+    if (prop.scope > scope) continue;
 
+    visible_props.push_back(&prop);
     writer.Write("\n");
 
-    std::string prop_id = ApiNameToIdentifier(prop.api_name()).c_str();
+    const std::string& prop_id = prop.identifier;
+    const char* prop_name = prop.prop->prop_name().c_str();
     std::string prop_type = GetJavaTypeName(prop);
 
-    if (prop.type() == sysprop::Enum || prop.type() == sysprop::EnumList) {
-      writer.Write("public static enum %s {\n",
-                   GetJavaEnumTypeName(prop).c_str());
+    if (prop.is_enum) {
+      writer.Write("public static enum %s {\n", prop.enum_type_name.c_str());
       writer.Indent();
-      std::vector<std::string> values =
-          android::base::Split(prop.enum_values(), "|");
-      for (int i = 0; i < values.size(); ++i) {
-        const std::string& name = values[i];
-        writer.Write("%s(\"%s\")", ToUpper(name).c_str(), name.c_str());
+      const std::vector<ResolvedEnumValue>& values = prop.enum_values;
+      for (size_t i = 0; i < values.size(); ++i) {
+        writer.Write("%s(\"%s\")", values[i].upper_name.c_str(),
+                     values[i].name.c_str());
         if (i + 1 < values.size()) {
           writer.Write(",\n");
         } else {
@@ -331,7 +836,7 @@ std::string GenerateJavaClass(const sysprop::Properties& props,
       writer.Write(
           "private final String propValue;\n"
           "private %s(String propValue) {\n",
-          GetJavaEnumTypeName(prop).c_str());
+          prop.enum_type_name.c_str());
       writer.Indent();
       writer.Write("this.propValue = propValue;\n");
       writer.Dedent();
@@ -344,19 +849,39 @@ std::string GenerateJavaClass(const sysprop::Properties& props,
       writer.Write("}\n");
       writer.Dedent();
       writer.Write("}\n\n");
+
+      if (options.lambda_free && prop.type == sysprop::EnumList &&
+          prop.writable) {
+        const std::string& enum_name = prop.enum_type_name;
+        writer.Write("private static String %s(List<%s> list) {\n",
+                     GetLambdaFreeEnumListFormatterName(prop).c_str(),
+                     enum_name.c_str());
+        writer.Indent();
+        writer.Write("StringJoiner joiner = new StringJoiner(\",\");\n\n");
+        writer.Write("for (%s element : list) {\n", enum_name.c_str());
+        writer.Indent();
+        writer.Write(
+            "joiner.add(element == null ? \"\" : element.getPropValue());\n");
+        writer.Dedent();
+        writer.Write("}\n\n");
+        writer.Write("return joiner.toString();\n");
+        writer.Dedent();
+        writer.Write("}\n\n");
+      }
     }
 
-    if (prop.deprecated()) {
+    if (prop.deprecated) {
       writer.Write("@Deprecated\n");
     }
 
-    if (IsListProp(prop)) {
+    if (prop.is_list) {
       writer.Write("public static %s %s() {\n", prop_type.c_str(),
                    prop_id.c_str());
       writer.Indent();
       writer.Write("String value = SystemProperties.get(\"%s\");\n",
-                   prop.prop_name().c_str());
-      writer.Write("return %s;\n", GetParsingExpression(prop).c_str());
+                   prop_name);
+      writer.Write("return %s;\n",
+                   GetParsingExpression(prop, options).c_str());
       writer.Dedent();
       writer.Write("}\n");
     } else {
@@ -364,40 +889,295 @@ std::string GenerateJavaClass(const sysprop::Properties& props,
                    prop_id.c_str());
       writer.Indent();
       writer.Write("String value = SystemProperties.get(\"%s\");\n",
-                   prop.prop_name().c_str());
+                   prop_name);
       writer.Write("return Optional.ofNullable(%s);\n",
-                   GetParsingExpression(prop).c_str());
+                   GetParsingExpression(prop, options).c_str());
       writer.Dedent();
       writer.Write("}\n");
     }
 
-    if (prop.access() != sysprop::Readonly) {
+    if (prop.writable) {
       writer.Write("\n");
-      if (prop.deprecated()) {
+      if (prop.deprecated) {
         writer.Write("@Deprecated\n");
       }
       writer.Write("public static void %s(%s value) {\n", prop_id.c_str(),
                    prop_type.c_str());
       writer.Indent();
       writer.Write("SystemProperties.set(\"%s\", value == null ? \"\" : %s);\n",
-                   prop.prop_name().c_str(),
-                   GetFormattingExpression(prop).c_str());
+                   prop_name, GetFormattingExpression(prop, options).c_str());
+      writer.Dedent();
+      writer.Write("}\n");
+    }
+
+    std::string array_type = GetJavaPrimitiveArrayTypeName(prop);
+    if (options.primitive_arrays && !array_type.empty()) {
+      std::string array_id = prop_id + "_array";
+      const char* deprecated = prop.deprecated ? "@Deprecated\n" : "";
+
+      writer.Write("\n%spublic static %s %s() {\n", deprecated,
+                   array_type.c_str(), array_id.c_str());
+      writer.Indent();
+      writer.Write("return %s((BitSet) null);\n", array_id.c_str());
+      writer.Dedent();
+      writer.Write("}\n");
+
+      writer.Write("\n%spublic static %s %s(BitSet valid) {\n",
+                   deprecated, array_type.c_str(), array_id.c_str());
+      writer.Indent();
+      writer.Write("String value = SystemProperties.get(\"%s\");\n",
+                   prop_name);
+      writer.Write("return %s(value, valid);\n",
+                   GetArrayParsingFunctionName(prop).c_str());
       writer.Dedent();
       writer.Write("}\n");
+
+      if (prop.writable) {
+        const char* formatter = prop.prop->integer_as_bool()
+                                    ? "formatIntegerAsBoolArray"
+                                    : "formatArray";
+        writer.Write("\n%spublic static void %s(%s value) {\n", deprecated,
+                     array_id.c_str(), array_type.c_str());
+        writer.Indent();
+        writer.Write(
+            "SystemProperties.set(\"%s\", value == null ? \"\" : %s(value));\n",
+            prop_name, formatter);
+        writer.Dedent();
+        writer.Write("}\n");
+      }
     }
+
+    if (options.change_callbacks) {
+      std::string value_type = GetJavaValueTypeName(prop);
+      std::string callback_type = "ChangeCallback<" + value_type + ">";
+      std::string callbacks = prop_id + "_changeCallbacks";
+      std::string last_value = prop_id + "_lastValue";
+      std::string pending_values = prop_id + "_pendingValues";
+      std::string dispatching = prop_id + "_dispatching";
+      const char* deprecated = prop.deprecated ? "@Deprecated\n" : "";
+
+      writer.Write(
+          "\nprivate static final ArrayList<%s> %s = new ArrayList<>();\n",
+          callback_type.c_str(), callbacks.c_str());
+      writer.Write("private static %s %s;\n", value_type.c_str(),
+                   last_value.c_str());
+      writer.Write(
+          "private static final ArrayDeque<%s> %s = new ArrayDeque<>();\n",
+          value_type.c_str(), pending_values.c_str());
+      writer.Write("private static boolean %s;\n", dispatching.c_str());
+
+      writer.Write(
+          "\n%spublic static void %s_addChangeCallback(%s callback) {\n",
+          deprecated, prop_id.c_str(), callback_type.c_str());
+      writer.Indent();
+      writer.Write("synchronized (sChangeCallbackLock) {\n");
+      writer.Indent();
+      writer.Write("if (%s.isEmpty()) %s = %s();\n", callbacks.c_str(),
+                   last_value.c_str(), prop_id.c_str());
+      writer.Write("%s.add(callback);\n", callbacks.c_str());
+      writer.Write("registerChangeCallbackLocked();\n");
+      writer.Dedent();
+      writer.Write("}\n");
+      writer.Dedent();
+      writer.Write("}\n");
+
+      writer.Write(
+          "\n%spublic static void %s_removeChangeCallback(%s callback) {\n",
+          deprecated, prop_id.c_str(), callback_type.c_str());
+      writer.Indent();
+      writer.Write("synchronized (sChangeCallbackLock) {\n");
+      writer.Indent();
+      writer.Write("%s.remove(callback);\n", callbacks.c_str());
+      writer.Dedent();
+      writer.Write("}\n");
+      writer.Dedent();
+      writer.Write("}\n");
+
+      // New values are queued under sChangeCallbackLock and delivered outside
+      // of it, so that callbacks may (un)register and a slow one holds no
+      // lock. The thread that finds no delivery in progress delivers the queue
+      // in order, so an overlapping dispatch can't deliver a stale value last.
+      std::string dispatcher = prop_id + "_dispatchChange";
+      writer.Write("\nprivate static void %s() {\n", dispatcher.c_str());
+      writer.Indent();
+      writer.Write("synchronized (sChangeCallbackLock) {\n");
+      writer.Indent();
+      writer.Write("if (%s.isEmpty()) return;\n", callbacks.c_str());
+      writer.Write("%s value = %s();\n", value_type.c_str(), prop_id.c_str());
+      writer.Write("if (value.equals(%s)) return;\n", last_value.c_str());
+      writer.Write("%s = value;\n", last_value.c_str());
+      writer.Write("%s.add(value);\n", pending_values.c_str());
+      writer.Write("if (%s) return;\n", dispatching.c_str());
+      writer.Write("%s = true;\n", dispatching.c_str());
+      writer.Dedent();
+      writer.Write("}\n");
+      writer.Write("boolean drained = false;\n");
+      writer.Write("try {\n");
+      writer.Indent();
+      writer.Write("for (;;) {\n");
+      writer.Indent();
+      writer.Write("%s value;\n", value_type.c_str());
+      writer.Write("ArrayList<%s> callbacks;\n", callback_type.c_str());
+      writer.Write("synchronized (sChangeCallbackLock) {\n");
+      writer.Indent();
+      writer.Write("value = %s.poll();\n", pending_values.c_str());
+      writer.Write("if (value == null) {\n");
+      writer.Indent();
+      writer.Write("%s = false;\n", dispatching.c_str());
+      writer.Write("drained = true;\n");
+      writer.Write("return;\n");
+      writer.Dedent();
+      writer.Write("}\n");
+      writer.Write("callbacks = new ArrayList<>(%s);\n", callbacks.c_str());
+      writer.Dedent();
+      writer.Write("}\n");
+      writer.Write("for (int i = 0; i < callbacks.size(); ++i) {\n");
+      writer.Indent();
+      writer.Write("callbacks.get(i).onChange(value);\n");
+      writer.Dedent();
+      writer.Write("}\n");
+      writer.Dedent();
+      writer.Write("}\n");
+      writer.Dedent();
+      // A throwing callback drops the rest of the queue but must not stop
+      // later changes from being delivered.
+      writer.Write("} finally {\n");
+      writer.Indent();
+      writer.Write("if (!drained) {\n");
+      writer.Indent();
+      writer.Write("synchronized (sChangeCallbackLock) {\n");
+      writer.Indent();
+      writer.Write("%s.clear();\n", pending_values.c_str());
+      writer.Write("%s = false;\n", dispatching.c_str());
+      writer.Dedent();
+      writer.Write("}\n");
+      writer.Dedent();
+      writer.Write("}\n");
+      writer.Dedent();
+      writer.Write("}\n");
+      writer.Dedent();
+      writer.Write("}\n");
+
+      dispatchers.push_back(dispatcher);
+    }
+  }
+
+  if (options.snapshot) {
+    writer.Write("\npublic static final class Snapshot {\n");
+    writer.Indent();
+    for (const ResolvedProperty* prop : visible_props) {
+      writer.Write("%spublic final %s %s;\n",
+                   prop->deprecated ? "@Deprecated\n" : "",
+                   GetJavaValueTypeName(*prop).c_str(),
+                   prop->identifier.c_str());
+    }
+    // The fields are read here rather than passed in, as a parameter per
+    // prop would exceed the JVM limit of 255 for large modules.
+    writer.Write("\nprivate Snapshot() {\n");
+    writer.Indent();
+    for (const ResolvedProperty* prop : visible_props) {
+      const char* prop_id = prop->identifier.c_str();
+      writer.Write("this.%s = %s();\n", prop_id, prop_id);
+    }
+    writer.Dedent();
+    writer.Write("}\n");
+    writer.Dedent();
+    writer.Write("}\n");
+
+    writer.Write(
+        "\n// Best effort: the props are re-read if a change was reported "
+        "meanwhile,\n// up to SNAPSHOT_MAX_ATTEMPTS times, and the last read "
+        "is returned either\n// way. Changes are reported asynchronously, so "
+        "one made while reading may\n// go unnoticed and the Snapshot may mix "
+        "old and new values.\n");
+    writer.Write("public static Snapshot snapshot() {\n");
+    writer.Indent();
+    writer.Write("synchronized (sChangeCallbackLock) {\n");
+    writer.Indent();
+    writer.Write("registerChangeCallbackLocked();\n");
+    writer.Dedent();
+    writer.Write("}\n");
+    writer.Write("Snapshot snapshot = null;\n");
+    writer.Write(
+        "for (int attempt = 0; attempt < SNAPSHOT_MAX_ATTEMPTS; ++attempt) "
+        "{\n");
+    writer.Indent();
+    writer.Write("int changeCount = sChangeCount;\n");
+    writer.Write("snapshot = new Snapshot();\n");
+    writer.Write("if (changeCount == sChangeCount) break;\n");
+    writer.Dedent();
+    writer.Write("}\n");
+    writer.Write("return snapshot;\n");
+    writer.Dedent();
+    writer.Write("}\n");
+  }
+
+  if (options.change_callbacks || options.snapshot) {
+    writer.Write("\nprivate static void onSystemPropertiesChanged() {\n");
+    writer.Indent();
+    if (options.snapshot) {
+      writer.Write("synchronized (sChangeCallbackLock) {\n");
+      writer.Indent();
+      writer.Write("++sChangeCount;\n");
+      writer.Dedent();
+      writer.Write("}\n");
+    }
+    for (const std::string& dispatcher : dispatchers) {
+      writer.Write("%s();\n", dispatcher.c_str());
+    }
+    writer.Dedent();
+    writer.Write("}\n");
   }
 
   writer.Dedent();
   writer.Write("}\n");
-
-  return writer.Code();
 }
 
 }  // namespace
 
+Result<std::string> GenerateJavaClass(const sysprop::Properties& props,
+                                      sysprop::Scope scope,
+                                      const JavaGenOptions& options) {
+  return GenerateJavaClass(ResolveProps(props), scope, options);
+}
+
+Result<std::string> GenerateJavaClass(const ResolvedProps& resolved,
+                                      sysprop::Scope scope,
+                                      const JavaGenOptions& options) {
+  StringCodeSink sink;
+  if (auto res = GenerateJavaClass(resolved, scope, options, &sink);
+      !res.ok()) {
+    return res.error();
+  }
+  return sink.TakeCode();
+}
+
+Result<void> GenerateJavaClass(const ResolvedProps& resolved,
+                               sysprop::Scope scope,
+                               const JavaGenOptions& options, CodeSink* sink) {
+  if (auto res = CheckJavaMemberNames(resolved, scope, options); !res.ok()) {
+    return res;
+  }
+  WriteJavaClass(resolved, scope, options, sink);
+  return {};
+}
+
+std::string GetJavaClassPath(const sysprop::Properties& props) {
+  std::string package_dir = GetJavaPackageName(props);
+  std::replace(package_dir.begin(), package_dir.end(), '.', '/');
+  return package_dir + "/" + GetJavaClassName(props) + ".java";
+}
+
+std::string GetJavaOutputPath(const sysprop::Properties& props,
+                              const std::string& java_output_dir) {
+  return java_output_dir + "/" + GetJavaClassPath(props);
+}
+
 Result<void> GenerateJavaLibrary(const std::string& input_file_path,
                                  sysprop::Scope scope,
-                                 const std::string& java_output_dir) {
+                                 const std::string& java_output_dir,
+                                 const JavaGenOptions& options,
+                                 std::vector<std::string>* changed_outputs) {
   sysprop::Properties props;
 
   if (auto res = ParseProps(input_file_path); res.ok()) {
@@ -406,10 +1186,22 @@ Result<void> GenerateJavaLibrary(const std::string& input_file_path,
     return res.error();
   }
 
-  std::string java_result = GenerateJavaClass(props, scope);
-  std::string package_name = GetJavaPackageName(props);
-  std::string java_package_dir =
-      java_output_dir + "/" + std::regex_replace(package_name, kRegexDot, "/");
+  return GenerateJavaLibrary(props, scope, java_output_dir, options,
+                             changed_outputs);
+}
+
+Result<void> GenerateJavaLibrary(const sysprop::Properties& props,
+                                 sysprop::Scope scope,
+                                 const std::string& java_output_dir,
+                                 const JavaGenOptions& options,
+                                 std::vector<std::string>* changed_outputs) {
+  ResolvedProps resolved = ResolveProps(props);
+  if (auto res = CheckJavaMemberNames(resolved, scope, options); !res.ok()) {
+    return res;
+  }
+
+  std::string java_output_file = GetJavaOutputPath(props, java_output_dir);
+  std::string java_package_dir = android::base::Dirname(java_output_file);
 
   std::error_code ec;
   std::filesystem::create_directories(java_package_dir, ec);
@@ -418,11 +1210,15 @@ Result<void> GenerateJavaLibrary(const std::string& input_file_path,
                   ec.message());
   }
 
-  std::string class_name = GetJavaClassName(props);
-  std::string java_output_file = java_package_dir + "/" + class_name + ".java";
-  if (!android::base::WriteStringToFile(java_result, java_output_file)) {
-    return ErrnoErrorf("Writing generated java class to {} failed",
-                       java_output_file);
+  auto res = WriteGeneratedFileIfChanged(java_output_file, [&](CodeSink* sink) {
+    WriteJavaClass(resolved, scope, options, sink);
+  });
+
+  if (!res.ok()) {
+    return Errorf("Writing generated java class to {} failed: {}",
+                  java_output_file, res.error().message());
+  } else if (*res && changed_outputs != nullptr) {
+    changed_outputs->push_back(java_output_file);
   }
 
   return {};
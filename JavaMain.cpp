@@ -17,39 +17,73 @@
 #define LOG_TAG "sysprop_java"
 
 #include <android-base/logging.h>
+#include <android-base/parseint.h>
 #include <android-base/result.h>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <set>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include <getopt.h>
 
+#include "Common.h"
 #include "JavaGen.h"
+#include "Parallel.h"
+#include "Worker.h"
 #include "sysprop.pb.h"
 
 using android::base::Result;
 
 namespace {
 
-struct Arguments {
-  std::string input_file_path;
-  std::string java_output_dir;
+struct Output {
   sysprop::Scope scope;
+  std::string java_output_dir;
+};
+
+struct Arguments {
+  std::vector<std::string> input_file_paths;
+  std::vector<Output> outputs;
+  JavaGenOptions options;
+  unsigned num_threads = 0;
+  std::string changed_outputs_path;
 };
 
-[[noreturn]] void PrintUsage(const char* exe_name) {
+void PrintUsage(const char* exe_name) {
   std::printf(
       "Usage: %s --scope (internal|public) --java-output-dir dir "
-      "sysprop_file\n",
-      exe_name);
-  std::exit(EXIT_FAILURE);
+      "[--lambda-free] [--primitive-arrays] [--change-callbacks] "
+      "[--snapshot] [--jobs n] [--changed-outputs file] sysprop_files...\n"
+      "       %s --persistent_worker [options]\n"
+      "\n"
+      "--scope and --java-output-dir may be repeated to generate several "
+      "scopes at once;\nthe n-th --java-output-dir then belongs to the n-th "
+      "--scope.\n"
+      "A sysprop file named - is read from stdin.\n"
+      "--changed-outputs file writes the paths of the outputs whose content "
+      "changed\nto file; the other outputs are left untouched.\n"
+      "With --persistent_worker, length-delimited work requests holding the "
+      "other\narguments are read from stdin and answered on stdout.\n",
+      exe_name, exe_name);
 }
 
 Result<void> ParseArgs(int argc, char* argv[], Arguments* args) {
+  std::vector<sysprop::Scope> scopes;
+  std::vector<std::string> java_output_dirs;
   for (;;) {
     static struct option long_options[] = {
         {"java-output-dir", required_argument, 0, 'j'},
         {"scope", required_argument, 0, 's'},
+        {"lambda-free", no_argument, 0, 'l'},
+        {"primitive-arrays", no_argument, 0, 'a'},
+        {"change-callbacks", no_argument, 0, 'b'},
+        {"snapshot", no_argument, 0, 'S'},
+        {"jobs", required_argument, 0, 'J'},
+        {"changed-outputs", required_argument, 0, 'o'},
+        {0, 0, 0, 0},
     };
 
     int opt = getopt_long_only(argc, argv, "", long_options, nullptr);
@@ -57,19 +91,39 @@ Result<void> ParseArgs(int argc, char* argv[], Arguments* args) {
 
     switch (opt) {
       case 'j':
-        args->java_output_dir = optarg;
+        java_output_dirs.emplace_back(optarg);
         break;
       case 's':
         if (strcmp(optarg, "public") == 0) {
-          args->scope = sysprop::Scope::Public;
+          scopes.push_back(sysprop::Scope::Public);
         } else if (strcmp(optarg, "internal") == 0) {
-          args->scope = sysprop::Scope::Internal;
+          scopes.push_back(sysprop::Scope::Internal);
         } else {
           return Errorf("Invalid option {} for scope", optarg);
         }
         break;
+      case 'l':
+        args->options.lambda_free = true;
+        break;
+      case 'a':
+        args->options.primitive_arrays = true;
+        break;
+      case 'b':
+        args->options.change_callbacks = true;
+        break;
+      case 'S':
+        args->options.snapshot = true;
+        break;
+      case 'J':
+        if (!android::base::ParseUint(optarg, &args->num_threads)) {
+          return Errorf("Invalid number of jobs {}", optarg);
+        }
+        break;
+      case 'o':
+        args->changed_outputs_path = optarg;
+        break;
       default:
-        PrintUsage(argv[0]);
+        return Errorf("Invalid arguments");
     }
   }
 
@@ -77,30 +131,126 @@ Result<void> ParseArgs(int argc, char* argv[], Arguments* args) {
     return Errorf("No input file specified");
   }
 
-  if (optind + 1 < argc) {
-    return Errorf("More than one input file");
+  if (scopes.empty()) {
+    return Errorf("No scope specified");
+  }
+
+  if (scopes.size() == 1) {
+    if (java_output_dirs.size() > 1) {
+      return Errorf("More than one --java-output-dir for a single scope");
+    }
+    if (java_output_dirs.empty()) java_output_dirs.emplace_back(".");
+  } else if (java_output_dirs.size() != scopes.size()) {
+    return Errorf("Got {} scopes but {} --java-output-dir", scopes.size(),
+                  java_output_dirs.size());
+  }
+
+  for (size_t i = 0; i < scopes.size(); ++i) {
+    args->outputs.push_back(Output{scopes[i], java_output_dirs[i]});
   }
 
-  args->input_file_path = argv[optind];
-  if (args->java_output_dir.empty()) args->java_output_dir = ".";
+  args->input_file_paths.assign(argv + optind, argv + argc);
+
+  std::set<std::string> unique_paths(args->input_file_paths.begin(),
+                                     args->input_file_paths.end());
+  if (unique_paths.size() != args->input_file_paths.size()) {
+    return Errorf("The same input file is given more than once");
+  }
 
   return {};
 }
 
-}  // namespace
+// Generates every requested scope from |props|, parsed once.
+Result<void> GenerateAllOutputs(const sysprop::Properties& props,
+                                const Arguments& args,
+                                std::vector<std::string>* changed_outputs) {
+  for (const Output& output : args.outputs) {
+    if (auto res = GenerateJavaLibrary(props, output.scope,
+                                       output.java_output_dir, args.options,
+                                       changed_outputs);
+        !res.ok()) {
+      return res;
+    }
+  }
 
-int main(int argc, char* argv[]) {
+  return {};
+}
+
+int Run(int argc, char* argv[]) {
   Arguments args;
-  std::string err;
   if (auto res = ParseArgs(argc, argv, &args); !res.ok()) {
     LOG(ERROR) << res.error();
     PrintUsage(argv[0]);
+    return EXIT_FAILURE;
   }
 
-  if (auto res = GenerateJavaLibrary(args.input_file_path, args.scope,
-                                     args.java_output_dir);
-      !res.ok()) {
-    LOG(FATAL) << "Error during generating java sysprop from "
-               << args.input_file_path << ": " << res.error();
+  const std::vector<std::string>& inputs = args.input_file_paths;
+  std::vector<sysprop::Properties> modules(inputs.size());
+  std::vector<Result<void>> results(inputs.size());
+  std::vector<std::vector<std::string>> changed_outputs(inputs.size());
+
+  // Report errors in input order regardless of which job finished first.
+  auto report_errors = [&] {
+    bool failed = false;
+    for (size_t i = 0; i < results.size(); ++i) {
+      if (!results[i].ok()) {
+        LOG(ERROR) << "Error during generating java sysprop from " << inputs[i]
+                   << ": " << results[i].error();
+        failed = true;
+      }
+    }
+    return failed;
+  };
+
+  ParallelFor(inputs.size(), args.num_threads, [&](size_t i) {
+    if (auto res = ParseProps(inputs[i]); res.ok()) {
+      modules[i] = std::move(*res);
+    } else {
+      results[i] = res.error();
+    }
+  });
+  if (report_errors()) return EXIT_FAILURE;
+
+  // Classes are named after the module, which only parsing reveals; two
+  // inputs with the same module would race writing the same file.
+  std::vector<std::string> output_paths;
+  for (const sysprop::Properties& props : modules) {
+    for (const Output& output : args.outputs) {
+      output_paths.push_back(GetJavaOutputPath(props, output.java_output_dir));
+    }
+  }
+  if (auto res = CheckDistinctOutputPaths(output_paths); !res.ok()) {
+    LOG(ERROR) << res.error();
+    return EXIT_FAILURE;
+  }
+
+  ParallelFor(inputs.size(), args.num_threads, [&](size_t i) {
+    results[i] = GenerateAllOutputs(modules[i], args, &changed_outputs[i]);
+  });
+  bool failed = report_errors();
+
+  if (!args.changed_outputs_path.empty()) {
+    std::vector<std::string> all_changed_outputs;
+    for (const auto& outputs : changed_outputs) {
+      all_changed_outputs.insert(all_changed_outputs.end(), outputs.begin(),
+                                 outputs.end());
+    }
+    if (auto res = WriteChangedOutputsFile(all_changed_outputs,
+                                           args.changed_outputs_path);
+        !res.ok()) {
+      LOG(ERROR) << res.error();
+      failed = true;
+    }
+  }
+
+  return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  if (IsPersistentWorker(argc, argv)) {
+    return RunPersistentWorker(argc, argv, Run);
   }
+  return Run(argc, argv);
 }
@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ResolvedProps.h"
+
+#include <string_view>
+
+#include "Common.h"
+
+ResolvedProps ResolveProps(const sysprop::Properties& props) {
+  ResolvedProps ret;
+  ret.props = &props;
+  ret.properties.reserve(props.prop_size());
+
+  for (const sysprop::Property& prop : props.prop()) {
+    ResolvedProperty& resolved = ret.properties.emplace_back();
+    resolved.prop = &prop;
+    resolved.identifier = ApiNameToIdentifier(prop.api_name());
+    resolved.type = prop.type();
+    resolved.scope = prop.scope();
+    resolved.is_list = IsListProp(prop);
+    resolved.is_enum =
+        prop.type() == sysprop::Enum || prop.type() == sysprop::EnumList;
+    resolved.writable = prop.access() != sysprop::Readonly;
+    resolved.deprecated = prop.deprecated();
+
+    if (!resolved.is_enum) continue;
+
+    resolved.enum_type_name = resolved.identifier + "_values";
+
+    std::string_view values = prop.enum_values();
+    for (;;) {
+      size_t end = values.find('|');
+      std::string_view name = values.substr(0, end);
+      ResolvedEnumValue& value = resolved.enum_values.emplace_back();
+      value.name = name;
+      value.upper_name = ToUpper(value.name);
+      if (end == std::string_view::npos) break;
+      values.remove_prefix(end + 1);
+    }
+  }
+
+  return ret;
+}
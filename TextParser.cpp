@@ -0,0 +1,440 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TextParser.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "CharClass.h"
+
+using android::base::Result;
+
+namespace {
+
+template <typename T>
+struct EnumName {
+  std::string_view name;
+  T value;
+};
+
+constexpr EnumName<sysprop::Access> kAccessNames[] = {
+    {"Readonly", sysprop::Readonly},
+    {"Writeonce", sysprop::Writeonce},
+    {"ReadWrite", sysprop::ReadWrite},
+};
+
+constexpr EnumName<sysprop::Owner> kOwnerNames[] = {
+    {"Platform", sysprop::Platform},
+    {"Vendor", sysprop::Vendor},
+    {"Odm", sysprop::Odm},
+};
+
+// System is deprecated but still accepted in sysprop files.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+constexpr EnumName<sysprop::Scope> kScopeNames[] = {
+    {"Public", sysprop::Public},
+    {"System", sysprop::System},
+    {"Internal", sysprop::Internal},
+};
+#pragma GCC diagnostic pop
+
+constexpr EnumName<sysprop::Type> kTypeNames[] = {
+    {"Boolean", sysprop::Boolean},
+    {"Integer", sysprop::Integer},
+    {"Long", sysprop::Long},
+    {"Double", sysprop::Double},
+    {"String", sysprop::String},
+    {"Enum", sysprop::Enum},
+    {"BooleanList", sysprop::BooleanList},
+    {"IntegerList", sysprop::IntegerList},
+    {"LongList", sysprop::LongList},
+    {"DoubleList", sysprop::DoubleList},
+    {"StringList", sysprop::StringList},
+    {"EnumList", sysprop::EnumList},
+};
+
+bool IsIdentifierStart(char ch) {
+  return IsCharInClasses(ch, kCharAlpha | kCharUnderscore);
+}
+
+bool IsIdentifierChar(char ch) {
+  return IsCharInClasses(ch, kCharAlpha | kCharDigit | kCharUnderscore);
+}
+
+int HexDigitValue(char ch) {
+  if (ch >= '0' && ch <= '9') return ch - '0';
+  if (ch >= 'a' && ch <= 'f') return ch - 'a' + 10;
+  if (ch >= 'A' && ch <= 'F') return ch - 'A' + 10;
+  return -1;
+}
+
+class TextParser {
+ public:
+  explicit TextParser(std::string_view text) : text_(text) {}
+
+  Result<void> Parse(sysprop::Properties* props) {
+    if (!ParseProperties(props, /*nested=*/false)) return Error();
+    return {};
+  }
+
+  Result<void> Parse(sysprop::SyspropLibraryApis* apis) {
+    for (;;) {
+      SkipWhitespace();
+      if (pos_ == text_.size()) return {};
+
+      std::string_view name;
+      if (!ParseFieldName(&name)) return Error();
+      if (name != "props") {
+        Fail("unsupported field");
+        return Error();
+      }
+      if (!ParseMessageStart() ||
+          !ParseProperties(apis->add_props(), /*nested=*/true) ||
+          !SkipFieldSeparator()) {
+        return Error();
+      }
+    }
+  }
+
+ private:
+  // Field bits used to reject singular fields given more than once, as
+  // TextFormat does.
+  enum : uint32_t {
+    kApiName = 1 << 0,
+    kType = 1 << 1,
+    kAccess = 1 << 2,
+    kScope = 1 << 3,
+    kPropName = 1 << 4,
+    kEnumValues = 1 << 5,
+    kIntegerAsBool = 1 << 6,
+    kDeprecated = 1 << 7,
+    kOwner = 1 << 8,
+    kModule = 1 << 9,
+  };
+
+  // Parses the fields of a Properties message, up to the closing brace if
+  // |nested| or the end of the input otherwise.
+  bool ParseProperties(sysprop::Properties* props, bool nested) {
+    uint32_t seen = 0;
+    for (;;) {
+      SkipWhitespace();
+      if (nested ? Consume('}') : pos_ == text_.size()) return true;
+      if (pos_ == text_.size()) return Fail("unexpected end of input");
+
+      std::string_view name;
+      if (!ParseFieldName(&name)) return false;
+
+      if (name == "prop") {
+        if (!ParseMessageStart() || !ParseProperty(props->add_prop())) {
+          return false;
+        }
+      } else if (name == "owner") {
+        sysprop::Owner owner;
+        if (!MarkSeen(kOwner, &seen) || !ParseColon() ||
+            !ParseEnum(kOwnerNames, &owner)) {
+          return false;
+        }
+        props->set_owner(owner);
+      } else if (name == "module") {
+        if (!MarkSeen(kModule, &seen) || !ParseColon() ||
+            !ParseString(props->mutable_module())) {
+          return false;
+        }
+      } else {
+        return Fail("unsupported field");
+      }
+
+      if (!SkipFieldSeparator()) return false;
+    }
+  }
+
+  // Parses the fields of a Property message up to the closing brace.
+  bool ParseProperty(sysprop::Property* prop) {
+    uint32_t seen = 0;
+    for (;;) {
+      SkipWhitespace();
+      if (Consume('}')) return true;
+      if (pos_ == text_.size()) return Fail("unexpected end of input");
+
+      std::string_view name;
+      if (!ParseFieldName(&name)) return false;
+
+      bool ok;
+      if (name == "api_name") {
+        ok = MarkSeen(kApiName, &seen) && ParseColon() &&
+             ParseString(prop->mutable_api_name());
+      } else if (name == "type") {
+        sysprop::Type type;
+        ok = MarkSeen(kType, &seen) && ParseColon() &&
+             ParseEnum(kTypeNames, &type);
+        if (ok) prop->set_type(type);
+      } else if (name == "access") {
+        sysprop::Access access;
+        ok = MarkSeen(kAccess, &seen) && ParseColon() &&
+             ParseEnum(kAccessNames, &access);
+        if (ok) prop->set_access(access);
+      } else if (name == "scope") {
+        sysprop::Scope scope;
+        ok = MarkSeen(kScope, &seen) && ParseColon() &&
+             ParseEnum(kScopeNames, &scope);
+        if (ok) prop->set_scope(scope);
+      } else if (name == "prop_name") {
+        ok = MarkSeen(kPropName, &seen) && ParseColon() &&
+             ParseString(prop->mutable_prop_name());
+      } else if (name == "enum_values") {
+        ok = MarkSeen(kEnumValues, &seen) && ParseColon() &&
+             ParseString(prop->mutable_enum_values());
+      } else if (name == "integer_as_bool") {
+        bool value;
+        ok = MarkSeen(kIntegerAsBool, &seen) && ParseColon() &&
+             ParseBool(&value);
+        if (ok) prop->set_integer_as_bool(value);
+      } else if (name == "deprecated") {
+        bool value;
+        ok = MarkSeen(kDeprecated, &seen) && ParseColon() &&
+             ParseBool(&value);
+        if (ok) prop->set_deprecated(value);
+      } else {
+        return Fail("unsupported field");
+      }
+
+      if (!ok || !SkipFieldSeparator()) return false;
+    }
+  }
+
+  void SkipWhitespace() {
+    while (pos_ < text_.size()) {
+      char ch = text_[pos_];
+      if (ch == '#') {
+        size_t end = text_.find('\n', pos_);
+        pos_ = end == std::string_view::npos ? text_.size() : end + 1;
+      } else if (ch == ' ' || ch == '\n' || ch == '\t' || ch == '\r' ||
+                 ch == '\v' || ch == '\f') {
+        ++pos_;
+      } else {
+        break;
+      }
+    }
+  }
+
+  bool Consume(char ch) {
+    if (pos_ < text_.size() && text_[pos_] == ch) {
+      ++pos_;
+      return true;
+    }
+    return false;
+  }
+
+  bool ParseIdentifier(std::string_view* identifier) {
+    SkipWhitespace();
+    size_t start = pos_;
+    if (pos_ == text_.size() || !IsIdentifierStart(text_[pos_])) {
+      return Fail("expected identifier");
+    }
+    while (pos_ < text_.size() && IsIdentifierChar(text_[pos_])) ++pos_;
+    *identifier = text_.substr(start, pos_ - start);
+    return true;
+  }
+
+  bool ParseFieldName(std::string_view* name) { return ParseIdentifier(name); }
+
+  bool ParseColon() {
+    SkipWhitespace();
+    return Consume(':') || Fail("expected \":\"");
+  }
+
+  // Message fields may omit the colon. Only the brace form is supported.
+  bool ParseMessageStart() {
+    SkipWhitespace();
+    Consume(':');
+    SkipWhitespace();
+    return Consume('{') || Fail("expected \"{\"");
+  }
+
+  bool SkipFieldSeparator() {
+    SkipWhitespace();
+    if (!Consume(',')) Consume(';');
+    return true;
+  }
+
+  bool MarkSeen(uint32_t field, uint32_t* seen) {
+    if (*seen & field) return Fail("non-repeated field specified twice");
+    *seen |= field;
+    return true;
+  }
+
+  template <typename T, size_t N>
+  bool ParseEnum(const EnumName<T> (&names)[N], T* value) {
+    SkipWhitespace();
+    size_t start = pos_;
+    std::string_view identifier;
+    if (!ParseIdentifier(&identifier)) return false;
+    for (const auto& entry : names) {
+      if (entry.name == identifier) {
+        *value = entry.value;
+        return true;
+      }
+    }
+    pos_ = start;
+    return Fail("unknown enum value");
+  }
+
+  bool ParseBool(bool* value) {
+    SkipWhitespace();
+    if (Consume('1')) {
+      *value = true;
+    } else if (Consume('0')) {
+      *value = false;
+    } else {
+      size_t start = pos_;
+      std::string_view identifier;
+      if (!ParseIdentifier(&identifier)) return false;
+      if (identifier == "true" || identifier == "True" || identifier == "t") {
+        *value = true;
+      } else if (identifier == "false" || identifier == "False" ||
+                 identifier == "f") {
+        *value = false;
+      } else {
+        pos_ = start;
+        return Fail("expected boolean");
+      }
+    }
+    if (pos_ < text_.size() && IsIdentifierChar(text_[pos_])) {
+      return Fail("expected boolean");
+    }
+    return true;
+  }
+
+  // Parses one or more adjacent quoted strings, which are concatenated.
+  bool ParseString(std::string* value) {
+    value->clear();
+    SkipWhitespace();
+    if (pos_ == text_.size() || (text_[pos_] != '"' && text_[pos_] != '\'')) {
+      return Fail("expected string");
+    }
+    do {
+      if (!ParseQuotedString(value)) return false;
+      SkipWhitespace();
+    } while (pos_ < text_.size() && (text_[pos_] == '"' || text_[pos_] == '\''));
+    return true;
+  }
+
+  bool ParseQuotedString(std::string* value) {
+    char quote = text_[pos_++];
+    for (;;) {
+      // Copy runs of plain characters at once.
+      size_t start = pos_;
+      while (pos_ < text_.size() && text_[pos_] != quote &&
+             text_[pos_] != '\\' && text_[pos_] != '\n') {
+        ++pos_;
+      }
+      value->append(text_.data() + start, pos_ - start);
+
+      if (pos_ == text_.size() || text_[pos_] == '\n') {
+        return Fail("unterminated string");
+      }
+      if (text_[pos_++] == quote) return true;
+      if (!ParseEscape(value)) return false;
+    }
+  }
+
+  // Parses the escape sequence following a backslash.
+  bool ParseEscape(std::string* value) {
+    if (pos_ == text_.size()) return Fail("unterminated string");
+    char ch = text_[pos_++];
+    switch (ch) {
+      case 'a': value->push_back('\a'); return true;
+      case 'b': value->push_back('\b'); return true;
+      case 'f': value->push_back('\f'); return true;
+      case 'n': value->push_back('\n'); return true;
+      case 'r': value->push_back('\r'); return true;
+      case 't': value->push_back('\t'); return true;
+      case 'v': value->push_back('\v'); return true;
+      case '\\':
+      case '?':
+      case '\'':
+      case '"':
+        value->push_back(ch);
+        return true;
+      case 'x':
+      case 'X': {
+        int code = 0;
+        int digits = 0;
+        while (digits < 2 && pos_ < text_.size() &&
+               HexDigitValue(text_[pos_]) >= 0) {
+          code = code * 16 + HexDigitValue(text_[pos_++]);
+          ++digits;
+        }
+        if (digits == 0) return Fail("invalid escape sequence");
+        value->push_back(static_cast<char>(code));
+        return true;
+      }
+      default:
+        if (ch >= '0' && ch <= '7') {
+          int code = ch - '0';
+          for (int digits = 1; digits < 3 && pos_ < text_.size() &&
+                               text_[pos_] >= '0' && text_[pos_] <= '7';
+               ++digits) {
+            code = code * 8 + (text_[pos_++] - '0');
+          }
+          value->push_back(static_cast<char>(code));
+          return true;
+        }
+        --pos_;
+        return Fail("unsupported escape sequence");
+    }
+  }
+
+  bool Fail(const char* message) {
+    error_pos_ = pos_;
+    error_ = message;
+    return false;
+  }
+
+  Result<void> Error() const {
+    size_t line = 1;
+    size_t line_start = 0;
+    for (size_t i = 0; i < error_pos_; ++i) {
+      if (text_[i] == '\n') {
+        ++line;
+        line_start = i + 1;
+      }
+    }
+    return Errorf("{}:{}: {}", line, error_pos_ - line_start + 1, error_);
+  }
+
+  std::string_view text_;
+  size_t pos_ = 0;
+  size_t error_pos_ = 0;
+  std::string error_;
+};
+
+}  // namespace
+
+Result<void> FastParseTextFormat(std::string_view text,
+                                 sysprop::Properties* message) {
+  message->Clear();
+  return TextParser(text).Parse(message);
+}
+
+Result<void> FastParseTextFormat(std::string_view text,
+                                 sysprop::SyspropLibraryApis* message) {
+  message->Clear();
+  return TextParser(text).Parse(message);
+}
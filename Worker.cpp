@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Worker.h"
+
+#include <getopt.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <android-base/logging.h>
+#include <android-base/unique_fd.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/util/delimited_message_util.h>
+
+#include "worker_protocol.pb.h"
+
+namespace {
+
+// Log output of the request being served, appended to from any thread.
+std::mutex output_lock;
+std::string* request_output = nullptr;
+
+void CaptureLogger(android::base::LogId id, android::base::LogSeverity severity,
+                   const char* tag, const char* file, unsigned int line,
+                   const char* message) {
+  std::lock_guard<std::mutex> lock(output_lock);
+  if (request_output == nullptr) {
+    android::base::StderrLogger(id, severity, tag, file, line, message);
+    return;
+  }
+  *request_output += message;
+  *request_output += '\n';
+}
+
+bool IsPersistentWorkerFlag(const char* arg) {
+  return strcmp(arg, "--persistent_worker") == 0 ||
+         strcmp(arg, "-persistent_worker") == 0;
+}
+
+}  // namespace
+
+bool IsPersistentWorker(int argc, char* argv[]) {
+  for (int i = 1; i < argc; ++i) {
+    if (IsPersistentWorkerFlag(argv[i])) return true;
+  }
+  return false;
+}
+
+int RunPersistentWorker(int argc, char* argv[], const ToolMain& tool_main) {
+  std::vector<std::string> startup_args;
+  for (int i = 0; i < argc; ++i) {
+    if (i == 0 || !IsPersistentWorkerFlag(argv[i])) {
+      startup_args.emplace_back(argv[i]);
+    }
+  }
+
+  // Keep the real stdout for responses only.
+  android::base::unique_fd out_fd(dup(STDOUT_FILENO));
+  if (out_fd == -1 || dup2(STDERR_FILENO, STDOUT_FILENO) == -1) {
+    PLOG(ERROR) << "Redirecting stdout failed";
+    return EXIT_FAILURE;
+  }
+
+  return ServeWorkRequests(STDIN_FILENO, out_fd, startup_args, tool_main);
+}
+
+int ServeWorkRequests(int in_fd, int out_fd,
+                      const std::vector<std::string>& startup_args,
+                      const ToolMain& tool_main) {
+  google::protobuf::io::FileInputStream input(in_fd);
+  google::protobuf::io::FileOutputStream output(out_fd);
+
+  android::base::SetLogger(CaptureLogger);
+
+  int ret = EXIT_SUCCESS;
+  for (;;) {
+    sysprop::worker::WorkRequest request;
+    bool clean_eof = false;
+    if (!google::protobuf::util::ParseDelimitedFromZeroCopyStream(
+            &request, &input, &clean_eof)) {
+      if (!clean_eof) {
+        LOG(ERROR) << "Error reading work request";
+        ret = EXIT_FAILURE;
+      }
+      break;
+    }
+
+    std::vector<std::string> args = startup_args;
+    args.insert(args.end(), request.arguments().begin(),
+                request.arguments().end());
+    std::vector<char*> argv;
+    for (std::string& arg : args) argv.push_back(arg.data());
+    argv.push_back(nullptr);
+
+    sysprop::worker::WorkResponse response;
+    {
+      std::lock_guard<std::mutex> lock(output_lock);
+      request_output = response.mutable_output();
+    }
+
+    // Make getopt start over for each request.
+    optind = 0;
+    response.set_exit_code(tool_main(argv.size() - 1, argv.data()));
+    response.set_request_id(request.request_id());
+    std::fflush(stdout);
+
+    {
+      std::lock_guard<std::mutex> lock(output_lock);
+      request_output = nullptr;
+    }
+
+    if (!google::protobuf::util::SerializeDelimitedToZeroCopyStream(
+            response, &output) ||
+        !output.Flush()) {
+      LOG(ERROR) << "Error writing work response";
+      ret = EXIT_FAILURE;
+      break;
+    }
+  }
+
+  android::base::SetLogger(android::base::StderrLogger);
+  return ret;
+}
@@ -0,0 +1,170 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Benchmarks of the sysprop tools themselves, over a generated sysprop file
+// with 10000 properties.
+
+#include <iterator>
+#include <string>
+
+#include <android-base/logging.h>
+#include <android-base/stringprintf.h>
+#include <benchmark/benchmark.h>
+
+#include "CodeWriter.h"
+#include "Common.h"
+#include "CppGen.h"
+#include "JavaGen.h"
+#include "ResolvedProps.h"
+
+namespace {
+
+constexpr int kNumProps = 10000;
+
+const char* const kTypes[] = {
+    "Boolean",
+    "Integer",
+    "Long",
+    "Double",
+    "String",
+    "Enum",
+    "BooleanList",
+    "IntegerList",
+    "LongList",
+    "DoubleList",
+    "StringList",
+    "EnumList",
+};
+
+const char* const kPropNamePrefixes[] = {"vendor.", "ro.vendor.",
+                                         "persist.vendor.", "ro.hardware."};
+
+// A Vendor-owned module, so that every prop name goes through the namespace
+// checks, with API names that need to be turned into identifiers.
+const std::string& GetBenchmarkSyspropFile() {
+  static const std::string contents = [] {
+    std::string ret =
+        "owner: Vendor\nmodule: \"vendor.benchmark.BenchmarkProperties\"\n";
+    for (int i = 0; i < kNumProps; ++i) {
+      const char* type = kTypes[i % std::size(kTypes)];
+      bool read_write = i % 3 == 0;
+      const char* prefix =
+          read_write ? "vendor."
+                     : kPropNamePrefixes[i % std::size(kPropNamePrefixes)];
+      android::base::StringAppendF(
+          &ret,
+          "prop {\n  api_name: \"bench_prop-%d\"\n  type: %s\n"
+          "  scope: %s\n  access: %s\n  prop_name: \"%sbench.prop_%d\"\n",
+          i, type, i % 2 == 0 ? "Public" : "Internal",
+          read_write ? "ReadWrite" : "Readonly", prefix, i);
+      if (std::string(type).find("Enum") == 0) {
+        ret += "  enum_values: \"first|second|third_value|fourth\"\n";
+      }
+      ret += "}\n";
+    }
+    return ret;
+  }();
+  return contents;
+}
+
+const sysprop::Properties& GetBenchmarkProps() {
+  static const sysprop::Properties props = [] {
+    auto res = ParsePropsFromString(GetBenchmarkSyspropFile());
+    CHECK(res.ok()) << res.error();
+    return *res;
+  }();
+  return props;
+}
+
+void BM_ParseProps(benchmark::State& state) {
+  const std::string& contents = GetBenchmarkSyspropFile();
+  for (auto _ : state) {
+    auto res = ParsePropsFromString(contents);
+    benchmark::DoNotOptimize(res);
+  }
+  state.SetBytesProcessed(state.iterations() * contents.size());
+}
+BENCHMARK(BM_ParseProps)->Unit(benchmark::kMillisecond);
+
+void BM_ApiNameToIdentifier(benchmark::State& state) {
+  const sysprop::Properties& props = GetBenchmarkProps();
+  for (auto _ : state) {
+    for (const sysprop::Property& prop : props.prop()) {
+      benchmark::DoNotOptimize(ApiNameToIdentifier(prop.api_name()));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * props.prop_size());
+}
+BENCHMARK(BM_ApiNameToIdentifier)->Unit(benchmark::kMillisecond);
+
+void BM_ResolveProps(benchmark::State& state) {
+  const sysprop::Properties& props = GetBenchmarkProps();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(ResolveProps(props));
+  }
+  state.SetItemsProcessed(state.iterations() * props.prop_size());
+}
+BENCHMARK(BM_ResolveProps)->Unit(benchmark::kMillisecond);
+
+// Lines shaped like generated accessors, written piecewise with indentation
+// changes in between.
+void BM_CodeWriter(benchmark::State& state) {
+  constexpr int kNumAccessors = 10000;
+  size_t bytes = 0;
+  for (auto _ : state) {
+    CodeWriter writer("    ");
+    for (int i = 0; i < kNumAccessors; ++i) {
+      writer.Write("public static Optional<Integer> prop_");
+      writer.Write(std::to_string(i));
+      writer.Write("() {\n");
+      writer.Indent();
+      writer.Write(
+          "String value = SystemProperties.get(\"vendor.prop\");\n"
+          "return Optional.ofNullable(tryParseInteger(value));\n");
+      writer.Dedent();
+      writer.Write("}\n\n");
+    }
+    bytes += writer.Code().size();
+    benchmark::DoNotOptimize(writer.Code());
+  }
+  state.SetBytesProcessed(bytes);
+}
+BENCHMARK(BM_CodeWriter)->Unit(benchmark::kMillisecond);
+
+void BM_GenerateCpp(benchmark::State& state) {
+  const sysprop::Properties& props = GetBenchmarkProps();
+  for (auto _ : state) {
+    // Like GenerateCppFiles(), resolve once for the three outputs.
+    ResolvedProps resolved = ResolveProps(props);
+    benchmark::DoNotOptimize(GenerateHeader(resolved, sysprop::Internal));
+    benchmark::DoNotOptimize(GenerateHeader(resolved, sysprop::Public));
+    benchmark::DoNotOptimize(
+        GenerateSource(resolved, "BenchmarkProperties.sysprop.h"));
+  }
+}
+BENCHMARK(BM_GenerateCpp)->Unit(benchmark::kMillisecond);
+
+void BM_GenerateJava(benchmark::State& state) {
+  const sysprop::Properties& props = GetBenchmarkProps();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(GenerateJavaClass(props, sysprop::Internal));
+  }
+}
+BENCHMARK(BM_GenerateJava)->Unit(benchmark::kMillisecond);
+
+}  // namespace
+
+BENCHMARK_MAIN();
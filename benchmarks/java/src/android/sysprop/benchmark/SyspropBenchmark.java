@@ -0,0 +1,329 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package android.sysprop.benchmark;
+
+import java.lang.management.ManagementFactory;
+import java.util.ArrayList;
+import java.util.Arrays;
+import java.util.List;
+
+// Measures every getter and setter of the classes generated from
+// BenchmarkProperties.sysprop (default output) and
+// LambdaFreeBenchmarkProperties.sysprop (--lambda-free), plus the
+// --primitive-arrays accessors, against the in-memory SystemProperties.
+//
+// Usage: sysprop_java_benchmark [filter]
+public final class SyspropBenchmark {
+    private static final int kWarmupIterations = 20_000;
+    private static final int kMinIterations = 10_000;
+    private static final long kTargetNanos = 200_000_000L;
+    private static final int kListSize = 16;
+
+    private interface Op {
+        Object run();
+    }
+
+    private static final class Case {
+        final String name;
+        final Op op;
+
+        Case(String name, Op op) {
+            this.name = name;
+            this.op = op;
+        }
+    }
+
+    private static volatile int sSink;
+
+    private static final com.sun.management.ThreadMXBean sThreadBean =
+            (com.sun.management.ThreadMXBean) ManagementFactory.getThreadMXBean();
+
+    private static long allocatedBytes() {
+        return sThreadBean.getThreadAllocatedBytes(Thread.currentThread().getId());
+    }
+
+    private static void run(Case c) {
+        for (int i = 0; i < kWarmupIterations; ++i) {
+            sSink += System.identityHashCode(c.op.run());
+        }
+
+        // Calibrate the iteration count so that each case runs for about
+        // kTargetNanos.
+        int iterations = kMinIterations;
+        long start = System.nanoTime();
+        for (int i = 0; i < iterations; ++i) {
+            sSink += System.identityHashCode(c.op.run());
+        }
+        long elapsed = System.nanoTime() - start;
+        if (elapsed > 0 && elapsed < kTargetNanos) {
+            iterations = (int) Math.min(Integer.MAX_VALUE,
+                    (long) iterations * kTargetNanos / elapsed);
+        }
+
+        long bytesBefore = allocatedBytes();
+        start = System.nanoTime();
+        for (int i = 0; i < iterations; ++i) {
+            sSink += System.identityHashCode(c.op.run());
+        }
+        elapsed = System.nanoTime() - start;
+        long bytes = allocatedBytes() - bytesBefore;
+
+        System.out.printf("%-56s %10.1f ns/op %10.1f B/op%n", c.name,
+                (double) elapsed / iterations, (double) bytes / iterations);
+    }
+
+    private static <T> List<T> repeat(T value) {
+        return new ArrayList<>(java.util.Collections.nCopies(kListSize, value));
+    }
+
+    private static void addBenchmarkPropertiesCases(List<Case> cases) {
+        final String p = "BenchmarkProperties.";
+        final List<Boolean> bools = repeat(Boolean.TRUE);
+        final List<Integer> ints = repeat(123456);
+        final List<Long> longs = repeat(1234567890123L);
+        final List<Double> doubles = repeat(3.14159);
+        final List<String> strings = repeat("str,ing");
+        final List<BenchmarkProperties.enum_list_prop_values> enums =
+                repeat(BenchmarkProperties.enum_list_prop_values.GAMMA);
+        final boolean[] boolArray = new boolean[kListSize];
+        final int[] intArray = new int[kListSize];
+        final long[] longArray = new long[kListSize];
+        final double[] doubleArray = new double[kListSize];
+        Arrays.fill(boolArray, true);
+        Arrays.fill(intArray, 123456);
+        Arrays.fill(longArray, 1234567890123L);
+        Arrays.fill(doubleArray, 3.14159);
+
+        BenchmarkProperties.bool_prop(true);
+        BenchmarkProperties.int_as_bool_prop(true);
+        BenchmarkProperties.int_prop(123456);
+        BenchmarkProperties.long_prop(1234567890123L);
+        BenchmarkProperties.double_prop(3.14159);
+        BenchmarkProperties.string_prop("string");
+        BenchmarkProperties.enum_prop(BenchmarkProperties.enum_prop_values.GAMMA);
+        BenchmarkProperties.bool_list_prop(bools);
+        BenchmarkProperties.int_as_bool_list_prop(bools);
+        BenchmarkProperties.int_list_prop(ints);
+        BenchmarkProperties.long_list_prop(longs);
+        BenchmarkProperties.double_list_prop(doubles);
+        BenchmarkProperties.string_list_prop(strings);
+        BenchmarkProperties.enum_list_prop(enums);
+
+        cases.add(new Case(p + "bool_prop()", () -> BenchmarkProperties.bool_prop()));
+        cases.add(new Case(p + "int_as_bool_prop()",
+                () -> BenchmarkProperties.int_as_bool_prop()));
+        cases.add(new Case(p + "int_prop()", () -> BenchmarkProperties.int_prop()));
+        cases.add(new Case(p + "long_prop()", () -> BenchmarkProperties.long_prop()));
+        cases.add(new Case(p + "double_prop()", () -> BenchmarkProperties.double_prop()));
+        cases.add(new Case(p + "string_prop()", () -> BenchmarkProperties.string_prop()));
+        cases.add(new Case(p + "enum_prop()", () -> BenchmarkProperties.enum_prop()));
+        cases.add(new Case(p + "bool_list_prop()",
+                () -> BenchmarkProperties.bool_list_prop()));
+        cases.add(new Case(p + "int_as_bool_list_prop()",
+                () -> BenchmarkProperties.int_as_bool_list_prop()));
+        cases.add(new Case(p + "int_list_prop()", () -> BenchmarkProperties.int_list_prop()));
+        cases.add(new Case(p + "long_list_prop()",
+                () -> BenchmarkProperties.long_list_prop()));
+        cases.add(new Case(p + "double_list_prop()",
+                () -> BenchmarkProperties.double_list_prop()));
+        cases.add(new Case(p + "string_list_prop()",
+                () -> BenchmarkProperties.string_list_prop()));
+        cases.add(new Case(p + "enum_list_prop()",
+                () -> BenchmarkProperties.enum_list_prop()));
+
+        cases.add(new Case(p + "bool_list_prop_array()",
+                () -> BenchmarkProperties.bool_list_prop_array()));
+        cases.add(new Case(p + "int_as_bool_list_prop_array()",
+                () -> BenchmarkProperties.int_as_bool_list_prop_array()));
+        cases.add(new Case(p + "int_list_prop_array()",
+                () -> BenchmarkProperties.int_list_prop_array()));
+        cases.add(new Case(p + "long_list_prop_array()",
+                () -> BenchmarkProperties.long_list_prop_array()));
+        cases.add(new Case(p + "double_list_prop_array()",
+                () -> BenchmarkProperties.double_list_prop_array()));
+
+        cases.add(new Case(p + "bool_prop(Boolean)", () -> {
+            BenchmarkProperties.bool_prop(true);
+            return null;
+        }));
+        cases.add(new Case(p + "int_as_bool_prop(Boolean)", () -> {
+            BenchmarkProperties.int_as_bool_prop(true);
+            return null;
+        }));
+        cases.add(new Case(p + "int_prop(Integer)", () -> {
+            BenchmarkProperties.int_prop(123456);
+            return null;
+        }));
+        cases.add(new Case(p + "long_prop(Long)", () -> {
+            BenchmarkProperties.long_prop(1234567890123L);
+            return null;
+        }));
+        cases.add(new Case(p + "double_prop(Double)", () -> {
+            BenchmarkProperties.double_prop(3.14159);
+            return null;
+        }));
+        cases.add(new Case(p + "string_prop(String)", () -> {
+            BenchmarkProperties.string_prop("string");
+            return null;
+        }));
+        cases.add(new Case(p + "enum_prop(enum_prop_values)", () -> {
+            BenchmarkProperties.enum_prop(BenchmarkProperties.enum_prop_values.GAMMA);
+            return null;
+        }));
+        cases.add(new Case(p + "bool_list_prop(List)", () -> {
+            BenchmarkProperties.bool_list_prop(bools);
+            return null;
+        }));
+        cases.add(new Case(p + "int_as_bool_list_prop(List)", () -> {
+            BenchmarkProperties.int_as_bool_list_prop(bools);
+            return null;
+        }));
+        cases.add(new Case(p + "int_list_prop(List)", () -> {
+            BenchmarkProperties.int_list_prop(ints);
+            return null;
+        }));
+        cases.add(new Case(p + "long_list_prop(List)", () -> {
+            BenchmarkProperties.long_list_prop(longs);
+            return null;
+        }));
+        cases.add(new Case(p + "double_list_prop(List)", () -> {
+            BenchmarkProperties.double_list_prop(doubles);
+            return null;
+        }));
+        cases.add(new Case(p + "string_list_prop(List)", () -> {
+            BenchmarkProperties.string_list_prop(strings);
+            return null;
+        }));
+        cases.add(new Case(p + "enum_list_prop(List)", () -> {
+            BenchmarkProperties.enum_list_prop(enums);
+            return null;
+        }));
+
+        cases.add(new Case(p + "bool_list_prop_array(boolean[])", () -> {
+            BenchmarkProperties.bool_list_prop_array(boolArray);
+            return null;
+        }));
+        cases.add(new Case(p + "int_as_bool_list_prop_array(boolean[])", () -> {
+            BenchmarkProperties.int_as_bool_list_prop_array(boolArray);
+            return null;
+        }));
+        cases.add(new Case(p + "int_list_prop_array(int[])", () -> {
+            BenchmarkProperties.int_list_prop_array(intArray);
+            return null;
+        }));
+        cases.add(new Case(p + "long_list_prop_array(long[])", () -> {
+            BenchmarkProperties.long_list_prop_array(longArray);
+            return null;
+        }));
+        cases.add(new Case(p + "double_list_prop_array(double[])", () -> {
+            BenchmarkProperties.double_list_prop_array(doubleArray);
+            return null;
+        }));
+    }
+
+    // Only the list paths differ between the default and lambda-free output.
+    private static void addLambdaFreeBenchmarkPropertiesCases(List<Case> cases) {
+        final String p = "LambdaFreeBenchmarkProperties.";
+        final List<Boolean> bools = repeat(Boolean.TRUE);
+        final List<Integer> ints = repeat(123456);
+        final List<Long> longs = repeat(1234567890123L);
+        final List<Double> doubles = repeat(3.14159);
+        final List<String> strings = repeat("str,ing");
+        final List<LambdaFreeBenchmarkProperties.enum_list_prop_values> enums =
+                repeat(LambdaFreeBenchmarkProperties.enum_list_prop_values.GAMMA);
+
+        LambdaFreeBenchmarkProperties.bool_list_prop(bools);
+        LambdaFreeBenchmarkProperties.int_as_bool_list_prop(bools);
+        LambdaFreeBenchmarkProperties.int_list_prop(ints);
+        LambdaFreeBenchmarkProperties.long_list_prop(longs);
+        LambdaFreeBenchmarkProperties.double_list_prop(doubles);
+        LambdaFreeBenchmarkProperties.string_list_prop(strings);
+        LambdaFreeBenchmarkProperties.enum_list_prop(enums);
+
+        cases.add(new Case(p + "bool_list_prop()",
+                () -> LambdaFreeBenchmarkProperties.bool_list_prop()));
+        cases.add(new Case(p + "int_as_bool_list_prop()",
+                () -> LambdaFreeBenchmarkProperties.int_as_bool_list_prop()));
+        cases.add(new Case(p + "int_list_prop()",
+                () -> LambdaFreeBenchmarkProperties.int_list_prop()));
+        cases.add(new Case(p + "long_list_prop()",
+                () -> LambdaFreeBenchmarkProperties.long_list_prop()));
+        cases.add(new Case(p + "double_list_prop()",
+                () -> LambdaFreeBenchmarkProperties.double_list_prop()));
+        cases.add(new Case(p + "string_list_prop()",
+                () -> LambdaFreeBenchmarkProperties.string_list_prop()));
+        cases.add(new Case(p + "enum_list_prop()",
+                () -> LambdaFreeBenchmarkProperties.enum_list_prop()));
+
+        cases.add(new Case(p + "bool_list_prop(List)", () -> {
+            LambdaFreeBenchmarkProperties.bool_list_prop(bools);
+            return null;
+        }));
+        cases.add(new Case(p + "int_as_bool_list_prop(List)", () -> {
+            LambdaFreeBenchmarkProperties.int_as_bool_list_prop(bools);
+            return null;
+        }));
+        cases.add(new Case(p + "int_list_prop(List)", () -> {
+            LambdaFreeBenchmarkProperties.int_list_prop(ints);
+            return null;
+        }));
+        cases.add(new Case(p + "long_list_prop(List)", () -> {
+            LambdaFreeBenchmarkProperties.long_list_prop(longs);
+            return null;
+        }));
+        cases.add(new Case(p + "double_list_prop(List)", () -> {
+            LambdaFreeBenchmarkProperties.double_list_prop(doubles);
+            return null;
+        }));
+        cases.add(new Case(p + "string_list_prop(List)", () -> {
+            LambdaFreeBenchmarkProperties.string_list_prop(strings);
+            return null;
+        }));
+        cases.add(new Case(p + "enum_list_prop(List)", () -> {
+            LambdaFreeBenchmarkProperties.enum_list_prop(enums);
+            return null;
+        }));
+    }
+
+    public static void main(String[] args) {
+        String filter = args.length > 0 ? args[0] : "";
+
+        // Time to the first list read from each generated class, which
+        // includes loading and initializing it and whatever it references.
+        // The lambda-free class goes first so that it can't benefit from the
+        // lambda and stream classes loaded by the default one.
+        long start = System.nanoTime();
+        sSink += LambdaFreeBenchmarkProperties.int_list_prop().size();
+        System.out.printf("%-56s %10.1f us%n", "LambdaFreeBenchmarkProperties first use",
+                (System.nanoTime() - start) / 1000.0);
+        start = System.nanoTime();
+        sSink += BenchmarkProperties.int_list_prop().size();
+        System.out.printf("%-56s %10.1f us%n", "BenchmarkProperties first use",
+                (System.nanoTime() - start) / 1000.0);
+
+        List<Case> cases = new ArrayList<>();
+        addBenchmarkPropertiesCases(cases);
+        addLambdaFreeBenchmarkPropertiesCases(cases);
+
+        for (Case c : cases) {
+            if (c.name.contains(filter)) run(c);
+        }
+    }
+
+    private SyspropBenchmark() {
+    }
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2026 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+package android.os;
+
+import java.util.ArrayList;
+import java.util.HashMap;
+
+// In-memory stand-in for the framework class, so that generated sysprop
+// classes can be exercised on a host JVM.
+public class SystemProperties {
+    private static final HashMap<String, String> sProps = new HashMap<>();
+    private static final ArrayList<Runnable> sChangeCallbacks = new ArrayList<>();
+
+    public static synchronized String get(String key) {
+        String val = sProps.get(key);
+        return val == null ? "" : val;
+    }
+    public static void set(String key, String val) {
+        ArrayList<Runnable> callbacks;
+        synchronized (SystemProperties.class) {
+            sProps.put(key, val);
+            if (sChangeCallbacks.isEmpty()) return;
+            callbacks = new ArrayList<>(sChangeCallbacks);
+        }
+        for (Runnable callback : callbacks) {
+            callback.run();
+        }
+    }
+    public static synchronized void addChangeCallback(Runnable callback) {
+        sChangeCallbacks.add(callback);
+    }
+    private SystemProperties() {
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <sys/uio.h>
+
+#include <android-base/result.h>
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Destination of the code written through a CodeWriter.
+class CodeSink {
+ public:
+  virtual ~CodeSink() = default;
+
+  virtual void Append(std::string_view code) = 0;
+
+  // Hints that about |size| more bytes of code are going to be appended.
+  virtual void Reserve(size_t /*size*/) {}
+};
+
+// Keeps the code in memory.
+class StringCodeSink : public CodeSink {
+ public:
+  void Append(std::string_view code) override {
+    code_.append(code);
+  }
+
+  void Reserve(size_t size) override {
+    code_.reserve(code_.size() + size);
+  }
+
+  const std::string& Code() const {
+    return code_;
+  }
+
+  std::string TakeCode() {
+    return std::move(code_);
+  }
+
+ private:
+  std::string code_;
+};
+
+// Streams the code to |fd| through a buffer of |buffer_size| bytes, so that
+// memory use doesn't grow with the size of the output. Code that doesn't fit
+// in the buffer is written along with the buffered code by a single writev().
+// After a write error, the rest of the code is dropped and Flush() reports
+// the error.
+class FdCodeSink : public CodeSink {
+ public:
+  static constexpr size_t kDefaultBufferSize = 64 * 1024;
+
+  explicit FdCodeSink(int fd, size_t buffer_size = kDefaultBufferSize);
+
+  void Append(std::string_view code) override;
+
+  // Writes out the buffered code. Must be called once everything has been
+  // appended; the destructor doesn't flush.
+  android::base::Result<void> Flush();
+
+ private:
+  FdCodeSink(const FdCodeSink&) = delete;
+  FdCodeSink& operator=(const FdCodeSink&) = delete;
+
+  void WriteFully(iovec* iov, int iovcnt);
+
+  const int fd_;
+  std::vector<char> buffer_;
+  size_t buffered_ = 0;
+  int errno_ = 0;
+};
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/result.h>
+#include <string>
+#include <vector>
+
+#include "CodeSink.h"
+#include "ResolvedProps.h"
+#include "sysprop.pb.h"
+
+// Return the C++ header generated for |props| in |scope| (Internal for the
+// regular header, Public for the public one), and the source file including
+// |include_name|.
+std::string GenerateHeader(const sysprop::Properties& props,
+                           sysprop::Scope scope);
+std::string GenerateSource(const sysprop::Properties& props,
+                           const std::string& include_name);
+
+// Same as above, for props already resolved with ResolveProps(); generating
+// several outputs from the same ResolvedProps avoids resolving it again.
+std::string GenerateHeader(const ResolvedProps& resolved, sysprop::Scope scope);
+std::string GenerateSource(const ResolvedProps& resolved,
+                           const std::string& include_name);
+
+// Same as above, streaming the generated code to |sink|.
+void GenerateHeader(const ResolvedProps& resolved, sysprop::Scope scope,
+                    CodeSink* sink);
+void GenerateSource(const ResolvedProps& resolved,
+                    const std::string& include_name, CodeSink* sink);
+
+// Returns the name the C++ files generated from |input_file_path| are based
+// on: its base name, or "<module name>.sysprop" when reading from stdin.
+std::string GetCppOutputBasename(const std::string& input_file_path,
+                                 const sysprop::Properties& props);
+
+// Returns the paths of the header, public header and source files that
+// GenerateCppFiles() writes for |output_basename| under the given dirs.
+std::vector<std::string> GetCppOutputPaths(const std::string& output_basename,
+                                           const std::string& header_dir,
+                                           const std::string& public_header_dir,
+                                           const std::string& source_output_dir);
+
+// An empty |include_name| stands for the generated header's own name.
+// Outputs whose content was unchanged are left untouched; the paths of the
+// ones that were (re)written are appended to |changed_outputs| if non-null.
+android::base::Result<void> GenerateCppFiles(
+    const std::string& input_file_path, const std::string& header_dir,
+    const std::string& public_header_dir, const std::string& source_output_dir,
+    const std::string& include_name,
+    std::vector<std::string>* changed_outputs = nullptr);
+
+// Same as above, for props that have already been parsed with ParseProps.
+// Generated files are named after |output_basename|, normally the base name
+// of the sysprop file.
+android::base::Result<void> GenerateCppFiles(
+    const sysprop::Properties& props, const std::string& output_basename,
+    const std::string& header_dir, const std::string& public_header_dir,
+    const std::string& source_output_dir, const std::string& include_name,
+    std::vector<std::string>* changed_outputs = nullptr);
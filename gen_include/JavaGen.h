@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) 2018 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/result.h>
+#include <string>
+#include <vector>
+
+#include "CodeSink.h"
+#include "ResolvedProps.h"
+#include "sysprop.pb.h"
+
+struct JavaGenOptions {
+  // Emit plain loops and per-type static parsers instead of helpers built on
+  // java.util.function and java.util.stream, so that initializing the
+  // generated class doesn't pull in the lambda and stream machinery.
+  bool lambda_free = false;
+
+  // Additionally emit <prop>_array() getters and setters for Boolean, Integer,
+  // Long and Double lists that work on primitive arrays instead of boxed lists.
+  // A prop named <prop>_array next to such a list can't be generated.
+  bool primitive_arrays = false;
+
+  // Emit <prop>_addChangeCallback() / <prop>_removeChangeCallback() which
+  // notify typed callbacks whenever the parsed value of the prop changes.
+  // Callbacks run with no lock held, possibly on the notification thread, and
+  // get the values of a prop one at a time, in order. Relies on
+  // SystemProperties.addChangeCallback(). Members named after a prop plus
+  // these suffixes must not clash with another prop's.
+  bool change_callbacks = false;
+
+  // Emit an immutable Snapshot class holding the value of every visible prop
+  // and a snapshot() factory that reads them all, re-reading a few times if a
+  // change was reported meanwhile. Change reports are asynchronous, so
+  // consistency is best effort. Relies on SystemProperties.addChangeCallback(),
+  // and conflicts with a prop named "snapshot".
+  bool snapshot = false;
+};
+
+// Returns the Java source of the class generated for |props| in |scope|. Fails
+// if |options| add a member whose name clashes with another one, e.g. the
+// <prop>_array() accessors of list prop foo and a prop named foo_array.
+android::base::Result<std::string> GenerateJavaClass(
+    const sysprop::Properties& props, sysprop::Scope scope,
+    const JavaGenOptions& options = {});
+
+// Same as above, for props already resolved with ResolveProps().
+android::base::Result<std::string> GenerateJavaClass(
+    const ResolvedProps& resolved, sysprop::Scope scope,
+    const JavaGenOptions& options = {});
+
+// Same as above, streaming the generated code to |sink|. Nothing is written
+// to |sink| on failure.
+android::base::Result<void> GenerateJavaClass(const ResolvedProps& resolved,
+                                              sysprop::Scope scope,
+                                              const JavaGenOptions& options,
+                                              CodeSink* sink);
+
+// Returns where GenerateJavaLibrary() puts the class generated for |props|,
+// relative to the output directory, e.g. "android/sysprop/Foo.java".
+std::string GetJavaClassPath(const sysprop::Properties& props);
+
+// Returns the path GenerateJavaLibrary() writes for |props| under
+// |java_output_dir|. Sysprop files with the same module share it.
+std::string GetJavaOutputPath(const sysprop::Properties& props,
+                              const std::string& java_output_dir);
+
+// The output is left untouched if its content is unchanged; its path is
+// appended to |changed_outputs| if non-null and it was (re)written.
+android::base::Result<void> GenerateJavaLibrary(
+    const std::string& input_file_path, sysprop::Scope scope,
+    const std::string& java_output_dir, const JavaGenOptions& options = {},
+    std::vector<std::string>* changed_outputs = nullptr);
+
+// Same as above, for props that have already been parsed with ParseProps.
+android::base::Result<void> GenerateJavaLibrary(
+    const sysprop::Properties& props, sysprop::Scope scope,
+    const std::string& java_output_dir, const JavaGenOptions& options = {},
+    std::vector<std::string>* changed_outputs = nullptr);
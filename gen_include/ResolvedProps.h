@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "sysprop.pb.h"
+
+// Everything the generators derive from a parsed sysprop file, computed once
+// so that generating several outputs doesn't redo the same string work for
+// every property.
+
+struct ResolvedEnumValue {
+  std::string name;        // as written in the sysprop file, e.g. "on"
+  std::string upper_name;  // enumerator name, e.g. "ON"
+};
+
+struct ResolvedProperty {
+  // Points into the sysprop::Properties the ResolvedProps was built from,
+  // which must outlive it.
+  const sysprop::Property* prop;
+
+  std::string identifier;      // ApiNameToIdentifier(prop->api_name())
+  std::string enum_type_name;  // identifier + "_values"; empty if not an enum
+  std::vector<ResolvedEnumValue> enum_values;
+
+  sysprop::Type type;
+  sysprop::Scope scope;
+  bool is_list;
+  bool is_enum;  // Enum or EnumList
+  bool writable;
+  bool deprecated;
+};
+
+struct ResolvedProps {
+  const sysprop::Properties* props;
+  std::vector<ResolvedProperty> properties;  // in declaration order
+};
+
+// |props| must have been validated by ParseProps().
+ResolvedProps ResolveProps(const sysprop::Properties& props);
@@ -0,0 +1,41 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+// Public header of libsysprop_gen, which lets tools run the sysprop generators
+// in-process without going through files:
+//
+//   auto props = ParsePropsFromString(contents);
+//   if (!props.ok()) return props.error();
+//   std::string header = GenerateHeader(*props, sysprop::Internal);
+//   std::string public_header = GenerateHeader(*props, sysprop::Public);
+//   std::string source = GenerateSource(*props, "Foo.sysprop.h");
+//   auto java = GenerateJavaClass(*props, sysprop::Public);
+//   if (!java.ok()) return java.error();
+//   std::string java_path = GetJavaClassPath(*props);
+//
+// Callers generating several outputs from the same props can resolve them
+// once with ResolveProps() and pass the ResolvedProps instead.
+//
+// The generators can also stream their output to a CodeSink, for instance
+// an FdCodeSink writing straight to a file, instead of returning a string.
+
+#include "CodeSink.h"
+#include "CppGen.h"
+#include "JavaGen.h"
+#include "ResolvedProps.h"
+#include "SyspropParser.h"
@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2018 The Android Open Source Project
+ * Copyright (C) 2019 The Android Open Source Project
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -17,10 +17,13 @@
 #pragma once
 
 #include <android-base/result.h>
-#include <string>
+#include <string_view>
 
 #include "sysprop.pb.h"
 
-android::base::Result<void> GenerateJavaLibrary(
-    const std::string& input_file_path, sysprop::Scope scope,
-    const std::string& java_output_dir);
\ No newline at end of file
+// Same as ParseProps() and ParseApiFile(), for contents that are already in
+// memory. They never touch the file system, including the cache.
+android::base::Result<sysprop::Properties> ParsePropsFromString(
+    std::string_view contents);
+android::base::Result<sysprop::SyspropLibraryApis> ParseApiFileFromString(
+    std::string_view contents);
@@ -18,8 +18,68 @@
 
 #include <android-base/result.h>
 #include <string>
+#include <vector>
+#include "Common.h"
+#include "api_check.pb.h"
 #include "sysprop.pb.h"
 
+struct ApiCheckOptions {
+  // Fingerprints written by sysprop_api_dump along with each file. If both
+  // are given, modules whose fingerprints match are compatible and skipped.
+  const ApiFingerprints* latest_fingerprints = nullptr;
+  const ApiFingerprints* current_fingerprints = nullptr;
+
+  // Threads comparing modules, as for ParallelFor(). CompareApiFiles() reads
+  // modules in order and ignores it.
+  unsigned num_threads = 0;
+};
+
+// Compares every module of |latest| with the one of the same name in
+// |current|, and fails with all of the incompatibilities found, one per line
+// prefixed by the module name. They are also stored in |report| if non-null,
+// sorted regardless of the number of threads.
+//
+// The messages are compared in place, without copying them, so they may live
+// on an arena. Current modules and props are indexed by name in sorted arrays
+// of pointers, which API dumps already are.
 android::base::Result<void> CompareApis(
     const sysprop::SyspropLibraryApis& latest,
-    const sysprop::SyspropLibraryApis& current);
+    const sysprop::SyspropLibraryApis& current,
+    const ApiCheckOptions& options = {},
+    sysprop::api_check::ApiCheckReport* report = nullptr);
+
+// One of the API snapshots that the current API is checked against.
+struct ApiBaseline {
+  const sysprop::SyspropLibraryApis* latest = nullptr;
+
+  // Fingerprints written along with |latest|, used in place of
+  // ApiCheckOptions::latest_fingerprints.
+  const ApiFingerprints* latest_fingerprints = nullptr;
+
+  // If non-null, receives the incompatibilities with this baseline.
+  sysprop::api_check::ApiCheckReport* report = nullptr;
+};
+
+// Same as CompareApis() for each of |baselines|, returning one result per
+// baseline. |current| is indexed once for all of them, and the modules of all
+// baselines are compared concurrently.
+std::vector<android::base::Result<void>> CompareApisWithBaselines(
+    const std::vector<ApiBaseline>& baselines,
+    const sysprop::SyspropLibraryApis& current,
+    const ApiCheckOptions& options = {});
+
+// Same as CompareApis(), reading the API files at |latest_path| and
+// |current_path| module by module in lockstep instead of parsing them whole,
+// so memory is bounded by the largest module. Modules of both files must be
+// sorted by name, as sysprop_api_dump writes them. Either path may be
+// kStdioFilePath.
+android::base::Result<void> CompareApiFiles(
+    const std::string& latest_path, const std::string& current_path,
+    const ApiCheckOptions& options = {},
+    sysprop::api_check::ApiCheckReport* report = nullptr);
+
+// Returns whether every module in |latest| has the same fingerprint in
+// |current|. The API files they were written with are then compatible, and
+// don't need to be parsed at all.
+bool FingerprintsMatch(const ApiFingerprints& latest,
+                       const ApiFingerprints& current);
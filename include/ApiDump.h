@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/result.h>
+#include <google/protobuf/arena.h>
+#include <string>
+#include <vector>
+
+#include "sysprop.pb.h"
+
+// Writes the API of the given modules to |output_file_path| in the format read
+// by ParseApiFile. Modules are sorted by name and props by API name so that the
+// dump doesn't depend on the order of the inputs. The file is left untouched
+// if its content is unchanged; otherwise its path is appended to
+// |changed_outputs| if non-null. kStdioFilePath writes to stdout instead.
+android::base::Result<void> DumpApis(
+    std::vector<sysprop::Properties> modules,
+    const std::string& output_file_path,
+    std::vector<std::string>* changed_outputs = nullptr);
+
+// Same as above, for modules allocated on |arena|, e.g. by ParseProps(). They
+// are moved into the dump, which is allocated on |arena| too, without being
+// copied.
+android::base::Result<void> DumpApis(
+    const std::vector<sysprop::Properties*>& modules,
+    google::protobuf::Arena* arena, const std::string& output_file_path,
+    std::vector<std::string>* changed_outputs = nullptr);
+
+// Writes the fingerprint of each module, as computed by
+// ComputeApiFingerprint(), to |output_file_path|. Given the fingerprints of
+// both API files, CompareApis() skips the modules whose fingerprints match.
+// The digest of |api_file_path|, where the modules were dumped, is written
+// first so that the fingerprints are ignored once that file changes. Output is
+// handled as by DumpApis().
+android::base::Result<void> DumpApiFingerprints(
+    const std::vector<sysprop::Properties*>& modules,
+    const std::string& api_file_path, const std::string& output_file_path,
+    std::vector<std::string>* changed_outputs = nullptr);
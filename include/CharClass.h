@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// Locale-independent character classes of the names used in sysprop files.
+// They can be or'ed together to describe the characters allowed in a name.
+enum CharClass : uint8_t {
+  kCharAlpha = 1 << 0,       // [A-Za-z]
+  kCharDigit = 1 << 1,       // [0-9]
+  kCharUnderscore = 1 << 2,  // _
+  kCharDash = 1 << 3,        // -
+  kCharDot = 1 << 4,         // .
+  kCharDollar = 1 << 5,      // $
+};
+
+inline constexpr std::array<uint8_t, 256> kCharClasses = [] {
+  std::array<uint8_t, 256> ret{};
+  for (int ch = 'a'; ch <= 'z'; ++ch) ret[ch] = kCharAlpha;
+  for (int ch = 'A'; ch <= 'Z'; ++ch) ret[ch] = kCharAlpha;
+  for (int ch = '0'; ch <= '9'; ++ch) ret[ch] = kCharDigit;
+  ret['_'] = kCharUnderscore;
+  ret['-'] = kCharDash;
+  ret['.'] = kCharDot;
+  ret['$'] = kCharDollar;
+  return ret;
+}();
+
+inline constexpr bool IsCharInClasses(char ch, uint8_t classes) {
+  return (kCharClasses[static_cast<uint8_t>(ch)] & classes) != 0;
+}
+
+namespace char_class_internal {
+
+inline constexpr uint64_t kOnes = 0x0101010101010101ULL;
+inline constexpr uint64_t kHighBits = 0x8080808080808080ULL;
+inline constexpr uint64_t kLowBits = 0x7f7f7f7f7f7f7f7fULL;
+
+// These return the high bit of each byte of |word| that satisfies the test.
+// All bytes of |word| must be ASCII.
+inline uint64_t BytesEqual(uint64_t word, char ch) {
+  uint64_t diff = word ^ (kOnes * static_cast<uint8_t>(ch));
+  return ~(((diff & kLowBits) + kLowBits) | diff) & kHighBits;
+}
+
+inline uint64_t BytesInRange(uint64_t word, char lo, char hi) {
+  uint64_t at_least_lo = word + kOnes * (0x80 - lo);
+  uint64_t above_hi = word + kOnes * (0x7f - hi);
+  return at_least_lo & ~above_hi & kHighBits;
+}
+
+// Returns whether all eight bytes of |word| belong to |classes|.
+inline bool AllBytesInClasses(uint64_t word, uint8_t classes) {
+  if ((word & kHighBits) != 0) return false;
+
+  uint64_t matches = 0;
+  if (classes & kCharAlpha) {
+    matches |= BytesInRange(word, 'a', 'z') | BytesInRange(word, 'A', 'Z');
+  }
+  if (classes & kCharDigit) matches |= BytesInRange(word, '0', '9');
+  if (classes & kCharUnderscore) matches |= BytesEqual(word, '_');
+  if (classes & kCharDash) matches |= BytesEqual(word, '-');
+  if (classes & kCharDot) matches |= BytesEqual(word, '.');
+  if (classes & kCharDollar) matches |= BytesEqual(word, '$');
+  return matches == kHighBits;
+}
+
+}  // namespace char_class_internal
+
+// Returns whether every character of |str| belongs to |classes|. Eight
+// characters are checked at a time with word-wide arithmetic.
+inline bool AreAllCharsInClasses(std::string_view str, uint8_t classes) {
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= str.size(); i += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, str.data() + i, sizeof(word));
+    if (!char_class_internal::AllBytesInClasses(word, classes)) return false;
+  }
+  for (; i < str.size(); ++i) {
+    if (!IsCharInClasses(str[i], classes)) return false;
+  }
+  return true;
+}
+
+// Returns whether |name| is non-empty, starts with a character of
+// |first_classes| and continues with characters of |classes|.
+inline bool IsNameInClasses(std::string_view name, uint8_t first_classes,
+                            uint8_t classes) {
+  return !name.empty() && IsCharInClasses(name[0], first_classes) &&
+         AreAllCharsInClasses(name.substr(1), classes);
+}
@@ -16,27 +16,50 @@
 
 #pragma once
 
+#include <cstddef>
 #include <string>
+#include <string_view>
+#include <vector>
+
+#include "CodeSink.h"
 
 class CodeWriter {
  public:
+  // Keeps the code in memory, to be retrieved with Code().
   explicit CodeWriter(std::string indent);
 
+  // Sends the code to |sink|, which must outlive the writer.
+  CodeWriter(std::string indent, CodeSink* sink);
+
   void Write(const char* format, ...) __attribute__((format(__printf__, 2, 3)));
 
+  // Writes |code| as is, without printf formatting.
+  void Write(std::string_view code);
+
   void Indent();
   void Dedent();
 
-  const std::string& Code() const {
-    return code_;
+  // Hints that about |size| more bytes of code are going to be written.
+  void Reserve(size_t size) {
+    sink_->Reserve(size);
   }
 
+  // Only available when the code is kept in memory.
+  const std::string& Code() const;
+
  private:
   CodeWriter(const CodeWriter&) = delete;
   CodeWriter& operator=(const CodeWriter&) = delete;
 
   int indent_level_ = 0;
   bool start_of_line_ = true;
-  std::string code_;
+  StringCodeSink string_sink_;
+  CodeSink* const sink_;
   const std::string indent_;
+
+  // indents_[i] is |indent_| repeated i times.
+  std::vector<std::string> indents_;
+
+  // Reused for the output of vsnprintf.
+  std::string scratch_;
 };
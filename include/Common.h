@@ -17,17 +17,129 @@
 #pragma once
 
 #include <android-base/result.h>
+#include <android-base/unique_fd.h>
+#include <google/protobuf/arena.h>
+#include <functional>
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "SyspropParser.h"
 #include "sysprop.pb.h"
 
+class CodeSink;
+
 inline static constexpr const char* kGeneratedFileFooterComments =
     "// Generated by the sysprop generator. DO NOT EDIT!\n\n";
 
+// Input path meaning stdin, and output path meaning stdout, where supported.
+inline static constexpr const char* kStdioFilePath = "-";
+
 std::string ApiNameToIdentifier(const std::string& name);
 std::string GetModuleName(const sysprop::Properties& props);
 bool IsListProp(const sysprop::Property& prop);
+// ParseProps() and ParseApiFile() return validated messages with default
+// values set. They read stdin if |file_path| is kStdioFilePath, and parse
+// regular files in place through a memory mapping. If SYSPROP_CACHE_DIR is
+// set, successfully parsed messages are cached there in binary form, keyed by
+// the hash of the input contents.
 android::base::Result<sysprop::Properties> ParseProps(
     const std::string& file_path);
 android::base::Result<sysprop::SyspropLibraryApis> ParseApiFile(
     const std::string& file_path);
+
+// Same as above, allocating the returned message on |arena|, which owns it.
+// Parsing many modules onto one arena replaces a heap allocation for every
+// message and string with a few large blocks freed at once.
+android::base::Result<sysprop::Properties*> ParseProps(
+    const std::string& file_path, google::protobuf::Arena* arena);
+android::base::Result<sysprop::SyspropLibraryApis*> ParseApiFile(
+    const std::string& file_path, google::protobuf::Arena* arena);
+
+// Reads the modules of an API file one at a time, holding only the module
+// being parsed in memory. Each module is validated and has default values
+// set, as by ParseApiFile(), but duplicate modules are left to the caller.
+class ApiFileReader {
+ public:
+  ApiFileReader() = default;
+
+  // Reads stdin if |file_path| is kStdioFilePath.
+  android::base::Result<void> Open(const std::string& file_path);
+
+  // Parses the next module into |props|, or returns false at the end of the
+  // file.
+  android::base::Result<bool> Next(sysprop::Properties* props);
+
+ private:
+  ApiFileReader(const ApiFileReader&) = delete;
+  ApiFileReader& operator=(const ApiFileReader&) = delete;
+
+  android::base::unique_fd owned_fd_;
+  int fd_ = -1;
+  std::string source_;
+
+  // Input read but not parsed yet starts at |buffer_[pos_]|, on line |line_|.
+  std::string buffer_;
+  size_t pos_ = 0;
+  int line_ = 1;
+  bool eof_ = false;
+};
+
+// Arena options suited to holding parsed sysprop and API files.
+google::protobuf::ArenaOptions GetParseArenaOptions();
+
 std::string ToUpper(std::string str);
+
+// Atomically replaces the file at |path| with |content| by writing to a
+// temporary file and renaming it into place. If the file already holds
+// exactly |content| it is left untouched, so that its mtime doesn't change
+// and build systems that restat outputs can skip dependent steps. Returns
+// whether the file was written.
+android::base::Result<bool> WriteStringToFileIfChanged(
+    const std::string& content, const std::string& path);
+
+// Same as above, for content that |generate| streams to the given sink. It is
+// written to the temporary file right away and compared afterwards, so the
+// whole content is never held in memory.
+android::base::Result<bool> WriteGeneratedFileIfChanged(
+    const std::string& path, const std::function<void(CodeSink*)>& generate);
+
+// Fingerprints of modules keyed by module name, as written by
+// sysprop_api_dump --fingerprints.
+using ApiFingerprints = std::unordered_map<std::string, std::string>;
+
+// Key of the first line of fingerprints files, which holds the digest of the
+// API file written along with them.
+inline static constexpr const char* kApiFileDigestKey = "sha256";
+
+// Returns a hash of the fields of |props| that CompareApis() checks,
+// independent of the order of its props. Two modules with the same
+// fingerprint are compatible with each other.
+std::string ComputeApiFingerprint(const sysprop::Properties& props);
+
+// Returns the SHA-256 digest of the contents of |path| as hex digits, like
+// sha256sum prints it.
+android::base::Result<std::string> ComputeFileDigest(const std::string& path);
+
+// Reads a fingerprints file. Its first line is "sha256 <digest>", with the
+// ComputeFileDigest() of the API file written along with it, which is stored
+// in |api_file_digest|. Each other line holds a "module fingerprint" pair.
+android::base::Result<ApiFingerprints> ReadApiFingerprints(
+    const std::string& path, std::string* api_file_digest);
+
+// Reads the fingerprints written along with |api_file_path| into
+// |fingerprints|. Returns whether they can be trusted, i.e. whether the API
+// file is still the one they were written for. An API file read from stdin
+// can't be checked, so its fingerprints are never trusted.
+android::base::Result<bool> ReadApiFingerprintsFor(
+    const std::string& fingerprints_path, const std::string& api_file_path,
+    ApiFingerprints* fingerprints);
+
+// Fails naming the first path of |output_paths| that appears more than once,
+// i.e. a file that more than one generation step would write.
+android::base::Result<void> CheckDistinctOutputPaths(
+    const std::vector<std::string>& output_paths);
+
+// Writes |changed_outputs| to |path|, one per line.
+android::base::Result<void> WriteChangedOutputsFile(
+    const std::vector<std::string>& changed_outputs, const std::string& path);
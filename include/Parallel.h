@@ -0,0 +1,28 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+// Calls fn(0), ..., fn(count - 1) on a pool of at most num_threads threads
+// (0 means one per hardware thread), including the calling thread, and
+// returns once all calls have finished. The order in which indices are
+// processed is unspecified, so fn should write its result to a slot owned by
+// its index.
+void ParallelFor(size_t count, unsigned num_threads,
+                 const std::function<void(size_t)>& fn);
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <android-base/result.h>
+#include <string_view>
+
+#include "sysprop.pb.h"
+
+// Recursive-descent parsers for the text format of sysprop files and API
+// files, which fill the messages directly instead of going through protobuf
+// reflection like google::protobuf::TextFormat.
+//
+// They understand the subset of the text format that sysprop files use in
+// practice: "name: value" fields, "name {...}" messages, enum values by name,
+// quoted strings and comments. Anything else, including input TextFormat would
+// reject, makes them fail with a "line:column: message" error, in which case
+// the caller should fall back to TextFormat. |message| is cleared first, and
+// is in an unspecified state after a failure.
+android::base::Result<void> FastParseTextFormat(std::string_view text,
+                                                sysprop::Properties* message);
+android::base::Result<void> FastParseTextFormat(
+    std::string_view text, sysprop::SyspropLibraryApis* message);
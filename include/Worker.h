@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Runs a tool invocation with the given argc and argv, and returns its exit
+// status. It must not exit the process, and must not write to stdout.
+using ToolMain = std::function<int(int argc, char* argv[])>;
+
+// Returns whether the tool was started with --persistent_worker.
+bool IsPersistentWorker(int argc, char* argv[]);
+
+// Serves requests for a tool started with --persistent_worker, until stdin is
+// closed. The other startup arguments are prepended to the arguments of each
+// request. While serving, anything written to stdout goes to stderr instead
+// so that it can't corrupt the responses.
+int RunPersistentWorker(int argc, char* argv[], const ToolMain& tool_main);
+
+// Reads length-delimited sysprop.worker.WorkRequest messages from |in_fd|,
+// runs |tool_main| with |startup_args| followed by the request's arguments,
+// and writes a length-delimited sysprop.worker.WorkResponse holding its exit
+// status and log output to |out_fd|. Returns EXIT_SUCCESS once |in_fd|
+// reaches end of file between requests.
+int ServeWorkRequests(int in_fd, int out_fd,
+                      const std::vector<std::string>& startup_args,
+                      const ToolMain& tool_main);
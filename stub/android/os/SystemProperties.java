@@ -23,6 +23,8 @@ public class SystemProperties {
     }
     public static void set(String key, String val) {
     }
+    public static void addChangeCallback(Runnable callback) {
+    }
     private SystemProperties() {
     }
 }
@@ -14,13 +14,16 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <string>
+#include <utility>
 
 #include <android-base/test_utils.h>
 #include <gtest/gtest.h>
 
 #include "ApiChecker.h"
 #include "Common.h"
+#include "TestInputs.h"
 
 namespace {
 
@@ -142,6 +145,10 @@ props {
 
 }  // namespace
 
+const char* const kApiCheckerTestLatestApi = kLatestApi;
+const char* const kApiCheckerTestCurrentApi = kCurrentApi;
+const char* const kApiCheckerTestInvalidCurrentApi = kInvalidCurrentApi;
+
 TEST(SyspropTest, ApiCheckerTest) {
   TemporaryFile latest_file;
   close(latest_file.fd);
@@ -174,11 +181,295 @@ TEST(SyspropTest, ApiCheckerTest) {
   EXPECT_FALSE(res.ok());
 
   EXPECT_EQ(res.error().message(),
-            "Prop prop1 has been removed\n"
-            "Accessibility of prop prop3 has become more restrictive\n"
-            "Scope of prop prop3 has become more restrictive\n"
-            "Integer-as-bool of prop prop3 has been changed\n"
-            "Type of prop prop4 has been changed\n"
-            "Scope of prop prop4 has become more restrictive\n"
-            "Underlying property of prop prop4 has been changed\n");
+            "android.platprop: Prop prop1 has been removed\n"
+            "android.platprop: Accessibility of prop prop3 has become more "
+            "restrictive\n"
+            "android.platprop: Scope of prop prop3 has become more "
+            "restrictive\n"
+            "android.platprop: Integer-as-bool of prop prop3 has been "
+            "changed\n"
+            "android.platprop: Type of prop prop4 has been changed\n"
+            "android.platprop: Scope of prop prop4 has become more "
+            "restrictive\n"
+            "android.platprop: Underlying property of prop prop4 has been "
+            "changed\n");
+}
+
+TEST(SyspropTest, ApiCheckerMissingModuleTest) {
+  auto latest = ParseApiFileFromString(kLatestApi);
+  ASSERT_RESULT_OK(latest);
+
+  // Every module of latest except android.all_dep has a Public prop that
+  // isn't deprecated.
+  sysprop::SyspropLibraryApis current;
+  auto res = CompareApis(*latest, current);
+  ASSERT_FALSE(res.ok());
+  EXPECT_NE(res.error().message().find(" has been removed\n"),
+            std::string::npos);
+  EXPECT_TRUE(current.props().empty());
+
+  sysprop::SyspropLibraryApis all_dep;
+  for (const sysprop::Properties& props : latest->props()) {
+    if (props.module() == "android.all_dep") *all_dep.add_props() = props;
+  }
+  ASSERT_EQ(all_dep.props_size(), 1);
+  EXPECT_RESULT_OK(CompareApis(all_dep, current));
+}
+
+TEST(SyspropTest, ApiCheckerUnsortedTest) {
+  auto latest = ParseApiFileFromString(kLatestApi);
+  ASSERT_RESULT_OK(latest);
+
+  // The index sorts current when it isn't already.
+  sysprop::SyspropLibraryApis current = *latest;
+  std::reverse(current.mutable_props()->begin(),
+               current.mutable_props()->end());
+  for (sysprop::Properties& props : *current.mutable_props()) {
+    std::reverse(props.mutable_prop()->begin(), props.mutable_prop()->end());
+  }
+  EXPECT_RESULT_OK(CompareApis(*latest, current));
+}
+
+TEST(SyspropTest, ApiCheckerStreamingTest) {
+  TemporaryFile latest_file;
+  ASSERT_TRUE(android::base::WriteStringToFile(kLatestApi, latest_file.path));
+  TemporaryFile current_file;
+  ASSERT_TRUE(android::base::WriteStringToFile(kCurrentApi, current_file.path));
+  TemporaryFile invalid_current_file;
+  ASSERT_TRUE(android::base::WriteStringToFile(kInvalidCurrentApi,
+                                               invalid_current_file.path));
+
+  EXPECT_RESULT_OK(CompareApiFiles(latest_file.path, current_file.path));
+
+  auto latest_api = ParseApiFile(latest_file.path);
+  ASSERT_RESULT_OK(latest_api);
+  auto invalid_current_api = ParseApiFile(invalid_current_file.path);
+  ASSERT_RESULT_OK(invalid_current_api);
+
+  auto expected = CompareApis(*latest_api, *invalid_current_api);
+  ASSERT_FALSE(expected.ok());
+  auto res = CompareApiFiles(latest_file.path, invalid_current_file.path);
+  ASSERT_FALSE(res.ok());
+  EXPECT_EQ(res.error().message(), expected.error().message());
+
+  // Modules only in current are skipped over.
+  sysprop::SyspropLibraryApis current = *latest_api;
+  current.mutable_props(0)->set_module("android.aaa");
+  current.add_props()->CopyFrom(latest_api->props(0));
+  current.mutable_props(2)->set_module("android.zzz");
+  current.add_props()->CopyFrom(latest_api->props(0));
+  std::sort(current.mutable_props()->begin(), current.mutable_props()->end(),
+            [](const auto& a, const auto& b) { return a.module() < b.module(); });
+  ASSERT_TRUE(android::base::WriteStringToFile(current.DebugString(),
+                                               current_file.path));
+  EXPECT_RESULT_OK(CompareApiFiles(latest_file.path, current_file.path));
+}
+
+TEST(SyspropTest, ApiCheckerStreamingUnsortedTest) {
+  auto latest = ParseApiFileFromString(kLatestApi);
+  ASSERT_RESULT_OK(latest);
+
+  sysprop::SyspropLibraryApis reversed = *latest;
+  std::reverse(reversed.mutable_props()->begin(),
+               reversed.mutable_props()->end());
+
+  TemporaryFile latest_file;
+  ASSERT_TRUE(android::base::WriteStringToFile(kLatestApi, latest_file.path));
+  TemporaryFile reversed_file;
+  ASSERT_TRUE(android::base::WriteStringToFile(reversed.DebugString(),
+                                               reversed_file.path));
+
+  // Unlike CompareApis(), streaming needs both files sorted.
+  EXPECT_RESULT_OK(CompareApis(*latest, reversed));
+  auto res = CompareApiFiles(latest_file.path, reversed_file.path);
+  ASSERT_FALSE(res.ok());
+  EXPECT_NE(res.error().message().find("must be sorted"), std::string::npos);
+  EXPECT_FALSE(CompareApiFiles(reversed_file.path, latest_file.path).ok());
+}
+
+TEST(SyspropTest, ApiCheckerFingerprintsTest) {
+  auto latest = ParseApiFileFromString(kLatestApi);
+  ASSERT_RESULT_OK(latest);
+  auto invalid_current = ParseApiFileFromString(kInvalidCurrentApi);
+  ASSERT_RESULT_OK(invalid_current);
+
+  ApiFingerprints latest_fingerprints, current_fingerprints;
+  for (const sysprop::Properties& props : latest->props()) {
+    latest_fingerprints[props.module()] = ComputeApiFingerprint(props);
+  }
+  for (const sysprop::Properties& props : invalid_current->props()) {
+    current_fingerprints[props.module()] = ComputeApiFingerprint(props);
+  }
+  EXPECT_FALSE(FingerprintsMatch(latest_fingerprints, current_fingerprints));
+  EXPECT_TRUE(FingerprintsMatch(latest_fingerprints, latest_fingerprints));
+
+  ApiCheckOptions options;
+  options.latest_fingerprints = &latest_fingerprints;
+  options.current_fingerprints = &current_fingerprints;
+
+  // Differing fingerprints still get compared.
+  EXPECT_FALSE(CompareApis(*latest, *invalid_current, options).ok());
+
+  // Matching ones are trusted, which shows that the module is skipped.
+  current_fingerprints["android.platprop"] =
+      latest_fingerprints["android.platprop"];
+  EXPECT_RESULT_OK(CompareApis(*latest, *invalid_current, options));
+
+  TemporaryFile latest_file;
+  ASSERT_TRUE(android::base::WriteStringToFile(kLatestApi, latest_file.path));
+  TemporaryFile invalid_current_file;
+  ASSERT_TRUE(android::base::WriteStringToFile(kInvalidCurrentApi,
+                                               invalid_current_file.path));
+  EXPECT_FALSE(
+      CompareApiFiles(latest_file.path, invalid_current_file.path).ok());
+  EXPECT_RESULT_OK(CompareApiFiles(latest_file.path,
+                                   invalid_current_file.path, options));
+}
+
+TEST(SyspropTest, ApiCheckerReportTest) {
+  // Two broken modules, in reverse order, with a module-level break.
+  auto latest = ParseApiFileFromString(kLatestApi);
+  ASSERT_RESULT_OK(latest);
+  sysprop::Properties other = latest->props(1);
+  other.set_module("android.other");
+  other.mutable_prop()->DeleteSubrange(1, other.prop_size() - 1);
+
+  sysprop::SyspropLibraryApis unsorted_latest = *latest;
+  *unsorted_latest.add_props() = other;
+  std::reverse(unsorted_latest.mutable_props()->begin(),
+               unsorted_latest.mutable_props()->end());
+
+  auto current = ParseApiFileFromString(kInvalidCurrentApi);
+  ASSERT_RESULT_OK(current);
+  sysprop::Properties* current_other = current->add_props();
+  *current_other = other;
+  current_other->set_owner(sysprop::Vendor);
+  current_other->mutable_prop(0)->set_type(sysprop::Double);
+  current_other->mutable_prop(0)->set_prop_name("vendor.prop1");
+
+  sysprop::api_check::ApiCheckReport expected;
+  ApiCheckOptions options;
+  options.num_threads = 1;
+  auto expected_res =
+      CompareApis(unsorted_latest, *current, options, &expected);
+  ASSERT_FALSE(expected_res.ok());
+
+  using sysprop::api_check::Incompatibility;
+  ASSERT_EQ(expected.incompatibility_size(), 10);
+  const Incompatibility& first = expected.incompatibility(0);
+  EXPECT_EQ(first.module(), "android.other");
+  EXPECT_EQ(first.api_name(), "prop1");
+  EXPECT_EQ(first.kind(), Incompatibility::TypeChanged);
+  EXPECT_EQ(first.message(), "Type of prop prop1 has been changed");
+  EXPECT_EQ(expected.incompatibility(1).kind(),
+            Incompatibility::PropNameChanged);
+  const Incompatibility& owner = expected.incompatibility(2);
+  EXPECT_EQ(owner.module(), "android.other");
+  EXPECT_EQ(owner.api_name(), "");
+  EXPECT_EQ(owner.kind(), Incompatibility::OwnerChanged);
+  const Incompatibility& removed = expected.incompatibility(3);
+  EXPECT_EQ(removed.module(), "android.platprop");
+  EXPECT_EQ(removed.api_name(), "prop1");
+  EXPECT_EQ(removed.kind(), Incompatibility::PropRemoved);
+  EXPECT_EQ(expected_res.error().message().substr(0, 54),
+            "android.other: Type of prop prop1 has been changed\n"
+            "and");
+
+  // The report doesn't depend on threads.
+  for (unsigned num_threads : {0u, 2u, 8u}) {
+    sysprop::api_check::ApiCheckReport report;
+    options.num_threads = num_threads;
+    auto res = CompareApis(unsorted_latest, *current, options, &report);
+    ASSERT_FALSE(res.ok());
+    EXPECT_EQ(res.error().message(), expected_res.error().message());
+    EXPECT_EQ(report.SerializeAsString(), expected.SerializeAsString());
+  }
+
+  // Nor on streaming, which needs sorted files.
+  auto by_module = [](const auto& a, const auto& b) {
+    return a.module() < b.module();
+  };
+  std::sort(current->mutable_props()->begin(), current->mutable_props()->end(),
+            by_module);
+  sysprop::SyspropLibraryApis sorted_latest = unsorted_latest;
+  std::sort(sorted_latest.mutable_props()->begin(),
+            sorted_latest.mutable_props()->end(), by_module);
+  TemporaryFile latest_file;
+  ASSERT_TRUE(android::base::WriteStringToFile(sorted_latest.DebugString(),
+                                               latest_file.path));
+  TemporaryFile current_file;
+  ASSERT_TRUE(android::base::WriteStringToFile(current->DebugString(),
+                                               current_file.path));
+  sysprop::api_check::ApiCheckReport report;
+  auto res =
+      CompareApiFiles(latest_file.path, current_file.path, {}, &report);
+  ASSERT_FALSE(res.ok());
+  EXPECT_EQ(res.error().message(), expected_res.error().message());
+  EXPECT_EQ(report.SerializeAsString(), expected.SerializeAsString());
+}
+
+TEST(SyspropTest, ApiCheckerBaselinesTest) {
+  auto latest = ParseApiFileFromString(kLatestApi);
+  ASSERT_RESULT_OK(latest);
+  auto current = ParseApiFileFromString(kCurrentApi);
+  ASSERT_RESULT_OK(current);
+  auto invalid_current = ParseApiFileFromString(kInvalidCurrentApi);
+  ASSERT_RESULT_OK(invalid_current);
+
+  // The current API is compatible with itself but not with kLatestApi.
+  sysprop::api_check::ApiCheckReport reports[3];
+  std::vector<ApiBaseline> baselines(3);
+  for (size_t i = 0; i < baselines.size(); ++i) {
+    baselines[i].latest = i == 1 ? &*invalid_current : &*latest;
+    baselines[i].report = &reports[i];
+  }
+
+  auto results = CompareApisWithBaselines(baselines, *invalid_current);
+  ASSERT_EQ(results.size(), 3u);
+  auto expected = CompareApis(*latest, *invalid_current);
+  ASSERT_FALSE(expected.ok());
+  ASSERT_FALSE(results[0].ok());
+  EXPECT_EQ(results[0].error().message(), expected.error().message());
+  EXPECT_RESULT_OK(results[1]);
+  EXPECT_TRUE(reports[1].incompatibility().empty());
+  EXPECT_EQ(reports[2].SerializeAsString(), reports[0].SerializeAsString());
+  EXPECT_FALSE(reports[0].incompatibility().empty());
+
+  // Fingerprints are per baseline.
+  ApiFingerprints latest_fingerprints;
+  for (const sysprop::Properties& props : latest->props()) {
+    latest_fingerprints[props.module()] = ComputeApiFingerprint(props);
+  }
+  ApiCheckOptions options;
+  options.current_fingerprints = &latest_fingerprints;
+  baselines[2].latest_fingerprints = &latest_fingerprints;
+  results = CompareApisWithBaselines(baselines, *invalid_current, options);
+  EXPECT_FALSE(results[0].ok());
+  EXPECT_RESULT_OK(results[1]);
+  EXPECT_RESULT_OK(results[2]);
+
+  EXPECT_TRUE(CompareApisWithBaselines({}, *current).empty());
+}
+
+TEST(SyspropTest, ApiCheckerDuplicatedNamesTest) {
+  auto latest = ParseApiFileFromString(kLatestApi);
+  ASSERT_RESULT_OK(latest);
+
+  // Like the map the index replaced, the last module with a given name is the
+  // one compared, even when the modules have to be sorted first.
+  sysprop::SyspropLibraryApis current;
+  for (const sysprop::Properties& props : latest->props()) {
+    sysprop::Properties* stale = current.add_props();
+    stale->set_module(props.module());
+    stale->set_owner(props.owner());
+  }
+  current.add_props()->set_module("~unsorted");
+  for (const sysprop::Properties& props : latest->props()) {
+    *current.add_props() = props;
+  }
+  EXPECT_RESULT_OK(CompareApis(*latest, current));
+
+  std::swap(*current.mutable_props(0),
+            *current.mutable_props(current.props_size() - 1));
+  EXPECT_FALSE(CompareApis(*latest, current).ok());
 }
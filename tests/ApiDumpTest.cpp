@@ -0,0 +1,234 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <sys/stat.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/test_utils.h>
+#include <google/protobuf/text_format.h>
+#include <gtest/gtest.h>
+
+#include "ApiDump.h"
+#include "Common.h"
+
+namespace {
+
+constexpr const char* kModuleB =
+    R"(
+owner: Platform
+module: "android.b"
+prop {
+    api_name: "z"
+    type: Integer
+    scope: Public
+    access: ReadWrite
+    prop_name: "z"
+}
+prop {
+    api_name: "a"
+    type: String
+    scope: Internal
+    access: Readonly
+    prop_name: "ro.a"
+}
+)";
+
+constexpr const char* kModuleA =
+    R"(
+owner: Vendor
+module: "android.a"
+prop {
+    api_name: "prop"
+    type: Boolean
+    scope: Public
+    access: Readonly
+    prop_name: "ro.vendor.prop"
+}
+)";
+
+sysprop::Properties ParseText(const char* text) {
+  sysprop::Properties props;
+  EXPECT_TRUE(google::protobuf::TextFormat::ParseFromString(text, &props));
+  return props;
+}
+
+}  // namespace
+
+TEST(SyspropTest, ApiDumpTest) {
+  TemporaryFile file;
+  close(file.fd);
+  file.fd = -1;
+
+  ASSERT_RESULT_OK(
+      DumpApis({ParseText(kModuleB), ParseText(kModuleA)}, file.path));
+
+  auto res = ParseApiFile(file.path);
+  ASSERT_RESULT_OK(res);
+
+  ASSERT_EQ(res->props_size(), 2);
+  EXPECT_EQ(res->props(0).module(), "android.a");
+  EXPECT_EQ(res->props(1).module(), "android.b");
+  ASSERT_EQ(res->props(1).prop_size(), 2);
+  EXPECT_EQ(res->props(1).prop(0).api_name(), "a");
+  EXPECT_EQ(res->props(1).prop(1).api_name(), "z");
+
+  EXPECT_FALSE(
+      DumpApis({ParseText(kModuleA), ParseText(kModuleA)}, file.path).ok());
+}
+
+using namespace std::string_literals;
+
+TEST(SyspropTest, ApiDumpUnchangedOutputTest) {
+  TemporaryDir temp_dir;
+  std::string path = temp_dir.path + "/api.txt"s;
+
+  std::vector<std::string> changed_outputs;
+  ASSERT_RESULT_OK(DumpApis({ParseText(kModuleA)}, path, &changed_outputs));
+  EXPECT_EQ(changed_outputs, std::vector<std::string>{path});
+
+  struct stat before;
+  ASSERT_EQ(stat(path.c_str(), &before), 0);
+
+  changed_outputs.clear();
+  ASSERT_RESULT_OK(DumpApis({ParseText(kModuleA)}, path, &changed_outputs));
+  EXPECT_TRUE(changed_outputs.empty());
+
+  struct stat after;
+  ASSERT_EQ(stat(path.c_str(), &after), 0);
+  EXPECT_EQ(before.st_ino, after.st_ino);
+  EXPECT_EQ(before.st_mtim.tv_sec, after.st_mtim.tv_sec);
+  EXPECT_EQ(before.st_mtim.tv_nsec, after.st_mtim.tv_nsec);
+
+  auto res = WriteStringToFileIfChanged("other", path);
+  ASSERT_RESULT_OK(res);
+  EXPECT_TRUE(*res);
+
+  std::string content;
+  ASSERT_TRUE(android::base::ReadFileToString(path, &content));
+  EXPECT_EQ(content, "other");
+
+  res = WriteStringToFileIfChanged("other", path);
+  ASSERT_RESULT_OK(res);
+  EXPECT_FALSE(*res);
+
+  std::string list_path = temp_dir.path + "/changed.txt"s;
+  ASSERT_RESULT_OK(WriteChangedOutputsFile({path, path + ".x"}, list_path));
+  ASSERT_TRUE(android::base::ReadFileToString(list_path, &content));
+  EXPECT_EQ(content, path + "\n" + path + ".x\n");
+}
+
+TEST(SyspropTest, ApiDumpArenaTest) {
+  TemporaryDir temp_dir;
+  std::string heap_path = temp_dir.path + "/heap.txt"s;
+  std::string arena_path = temp_dir.path + "/arena.txt"s;
+  ASSERT_RESULT_OK(
+      DumpApis({ParseText(kModuleB), ParseText(kModuleA)}, heap_path));
+
+  google::protobuf::Arena arena;
+  std::vector<sysprop::Properties*> modules;
+  for (const char* text : {kModuleB, kModuleA}) {
+    auto* props =
+        google::protobuf::Arena::CreateMessage<sysprop::Properties>(&arena);
+    ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(text, props));
+    modules.push_back(props);
+  }
+  ASSERT_RESULT_OK(DumpApis(modules, &arena, arena_path));
+
+  std::string heap_dump, arena_dump;
+  ASSERT_TRUE(android::base::ReadFileToString(heap_path, &heap_dump));
+  ASSERT_TRUE(android::base::ReadFileToString(arena_path, &arena_dump));
+  EXPECT_EQ(heap_dump, arena_dump);
+
+  modules.clear();
+  for (int i = 0; i < 2; ++i) {
+    auto* props =
+        google::protobuf::Arena::CreateMessage<sysprop::Properties>(&arena);
+    ASSERT_TRUE(google::protobuf::TextFormat::ParseFromString(kModuleA, props));
+    modules.push_back(props);
+  }
+  EXPECT_FALSE(DumpApis(modules, &arena, arena_path).ok());
+}
+
+TEST(SyspropTest, ApiDumpFingerprintsTest) {
+  sysprop::Properties module_a = ParseText(kModuleA);
+  sysprop::Properties module_b = ParseText(kModuleB);
+
+  // The order of props doesn't matter.
+  sysprop::Properties changed = module_b;
+  std::swap(*changed.mutable_prop(0), *changed.mutable_prop(1));
+  EXPECT_EQ(ComputeApiFingerprint(changed), ComputeApiFingerprint(module_b));
+  changed.mutable_prop(0)->set_access(sysprop::Writeonce);
+  EXPECT_NE(ComputeApiFingerprint(changed), ComputeApiFingerprint(module_b));
+  EXPECT_NE(ComputeApiFingerprint(module_a), ComputeApiFingerprint(module_b));
+
+  TemporaryDir temp_dir;
+  std::string api_path = temp_dir.path + "/api.txt"s;
+  ASSERT_TRUE(android::base::WriteStringToFile("abc", api_path));
+  auto api_digest = ComputeFileDigest(api_path);
+  ASSERT_RESULT_OK(api_digest);
+  EXPECT_EQ(*api_digest,
+            "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+
+  std::string path = temp_dir.path + "/fingerprints.txt"s;
+  std::vector<std::string> changed_outputs;
+  ASSERT_RESULT_OK(DumpApiFingerprints({&module_b, &module_a}, api_path, path,
+                                       &changed_outputs));
+  EXPECT_EQ(changed_outputs, std::vector<std::string>{path});
+
+  std::string content;
+  ASSERT_TRUE(android::base::ReadFileToString(path, &content));
+  EXPECT_EQ(content, "sha256 " + *api_digest + "\nandroid.a " +
+                         ComputeApiFingerprint(module_a) + "\nandroid.b " +
+                         ComputeApiFingerprint(module_b) + "\n");
+
+  std::string digest;
+  auto fingerprints = ReadApiFingerprints(path, &digest);
+  ASSERT_RESULT_OK(fingerprints);
+  EXPECT_EQ(digest, *api_digest);
+  const ApiFingerprints expected = {
+      {"android.a", ComputeApiFingerprint(module_a)},
+      {"android.b", ComputeApiFingerprint(module_b)}};
+  EXPECT_EQ(*fingerprints, expected);
+
+  // The fingerprints are only trusted for the API file they were written
+  // with, which can't be checked when read from stdin.
+  ApiFingerprints trusted;
+  auto res = ReadApiFingerprintsFor(path, api_path, &trusted);
+  ASSERT_RESULT_OK(res);
+  EXPECT_TRUE(*res);
+  EXPECT_EQ(trusted, expected);
+  EXPECT_FALSE(*ReadApiFingerprintsFor(path, kStdioFilePath, &trusted));
+  ASSERT_TRUE(android::base::WriteStringToFile("abd", api_path));
+  EXPECT_FALSE(*ReadApiFingerprintsFor(path, api_path, &trusted));
+  EXPECT_FALSE(ReadApiFingerprintsFor(path, api_path + ".missing", &trusted)
+                   .ok());
+
+  for (const char* invalid : {
+           "",
+           "android.a 1\n",
+           "sha256\nandroid.a 1\n",
+           "sha256 1\nandroid.a\n",
+           "sha256 1\nandroid.a 1 2\n",
+           "sha256 1\nandroid.a 1\nandroid.a 1\n",
+       }) {
+    ASSERT_TRUE(android::base::WriteStringToFile(invalid, path));
+    EXPECT_FALSE(ReadApiFingerprints(path, &digest).ok()) << invalid;
+  }
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <random>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "CharClass.h"
+
+namespace {
+
+bool IsInClassesSlow(char ch, uint8_t classes) {
+  unsigned char uch = static_cast<unsigned char>(ch);
+  return ((classes & kCharAlpha) &&
+          ((uch >= 'a' && uch <= 'z') || (uch >= 'A' && uch <= 'Z'))) ||
+         ((classes & kCharDigit) && uch >= '0' && uch <= '9') ||
+         ((classes & kCharUnderscore) && uch == '_') ||
+         ((classes & kCharDash) && uch == '-') ||
+         ((classes & kCharDot) && uch == '.') ||
+         ((classes & kCharDollar) && uch == '$');
+}
+
+}  // namespace
+
+TEST(SyspropTest, CharClassTableTest) {
+  for (int ch = 0; ch < 256; ++ch) {
+    for (uint8_t classes = 0; classes < 64; ++classes) {
+      EXPECT_EQ(IsCharInClasses(static_cast<char>(ch), classes),
+                IsInClassesSlow(static_cast<char>(ch), classes))
+          << ch << " " << static_cast<int>(classes);
+    }
+  }
+}
+
+TEST(SyspropTest, CharClassScanTest) {
+  std::mt19937 rng(42);
+  // Mostly valid characters, with neighbours of the ranges and non-ASCII
+  // bytes mixed in.
+  const std::string alphabet =
+      "azAZ09_-.$aZ5@[`{/:\x7f\x80\xff\xaf\xc1 ";
+  for (int i = 0; i < 20000; ++i) {
+    std::string str(rng() % 40, ' ');
+    int bad_chars = rng() % 3 == 0 ? 1 : 0;
+    for (char& ch : str) {
+      ch = alphabet[rng() % (bad_chars ? alphabet.size() : 10)];
+    }
+    uint8_t classes = rng() % 64;
+
+    bool expected = true;
+    for (char ch : str) expected = expected && IsInClassesSlow(ch, classes);
+    EXPECT_EQ(AreAllCharsInClasses(str, classes), expected)
+        << str << " " << static_cast<int>(classes);
+  }
+
+  EXPECT_TRUE(IsNameInClasses("abcdefghijklmnop_0", kCharAlpha,
+                              kCharAlpha | kCharDigit | kCharUnderscore));
+  EXPECT_FALSE(IsNameInClasses("_abc", kCharAlpha, kCharAlpha));
+  EXPECT_FALSE(IsNameInClasses("", kCharAlpha, kCharAlpha));
+}
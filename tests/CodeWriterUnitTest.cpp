@@ -14,12 +14,22 @@
  * limitations under the License.
  */
 
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <filesystem>
 #include <string>
+#include <string_view>
 
+#include <android-base/file.h>
 #include <android-base/test_utils.h>
 #include <gtest/gtest.h>
 
 #include "CodeWriter.h"
+#include "Common.h"
+
+using namespace std::string_literals;
 
 namespace {
 
@@ -33,6 +43,32 @@ int main() {
 }
 )";
 
+// The original CodeWriter algorithm, appending character by character.
+class ReferenceCodeWriter {
+ public:
+  void Write(std::string_view code) {
+    for (char ch : code) {
+      if (ch == '\n') {
+        start_of_line_ = true;
+      } else if (start_of_line_) {
+        for (int i = 0; i < indent_level_; ++i) code_ += kIndent;
+        start_of_line_ = false;
+      }
+      code_.push_back(ch);
+    }
+  }
+
+  void Indent() { ++indent_level_; }
+  void Dedent() { --indent_level_; }
+
+  const std::string& Code() const { return code_; }
+
+ private:
+  int indent_level_ = 0;
+  bool start_of_line_ = true;
+  std::string code_;
+};
+
 }  // namespace
 
 TEST(SyspropTest, CodeWriterIndentOutputTest) {
@@ -62,3 +98,132 @@ TEST(SyspropTest, CodeWriterCodeGenerationTest) {
   writer.Write(kHelloWorld);
   ASSERT_EQ(writer.Code(), kHelloWorld);
 }
+
+TEST(SyspropTest, CodeWriterPartialLinesTest) {
+  CodeWriter writer(kIndent);
+  writer.Indent();
+  writer.Write("int %s", "x");
+  writer.Write(" = %d;\n\n", 1);
+  writer.Write(std::string_view("a\nb"));
+  writer.Indent();
+  writer.Write("c\n");
+  writer.Write("100%%\n");
+  writer.Dedent();
+  writer.Dedent();
+
+  // Longer than the initial scratch buffer.
+  std::string long_line(1000, 'x');
+  writer.Write("%s\n", long_line.c_str());
+  writer.Write("%d\n", 42);
+
+  ASSERT_EQ(writer.Code(), "    int x = 1;\n\n    a\n    bc\n        100%\n" +
+                               long_line + "\n42\n");
+}
+
+TEST(SyspropTest, CodeWriterMatchesReferenceTest) {
+  auto write_all = [](auto* writer) {
+    for (int i = 0; i < 1000; ++i) {
+      writer->Write("public static Optional<Integer> prop_");
+      writer->Write(std::to_string(i));
+      writer->Write("() {\n");
+      writer->Indent();
+      writer->Write(
+          "String value = SystemProperties.get(\"vendor.prop\");\n"
+          "return Optional.ofNullable(tryParseInteger(value));\n");
+      writer->Dedent();
+      writer->Write("}\n\n");
+    }
+  };
+
+  CodeWriter writer(kIndent);
+  write_all(&writer);
+  ReferenceCodeWriter reference;
+  write_all(&reference);
+  ASSERT_EQ(writer.Code(), reference.Code());
+}
+
+TEST(SyspropTest, CodeWriterFdSinkTest) {
+  TemporaryFile file;
+
+  // A tiny buffer, so that code goes through both the buffered and the
+  // writev() paths.
+  FdCodeSink sink(file.fd, 16);
+  CodeWriter writer(kIndent, &sink);
+  CodeWriter expected(kIndent);
+  for (int i = 0; i < 1000; ++i) {
+    for (CodeWriter* w : {&writer, &expected}) {
+      w->Write("line %d\n", i);
+      if (i % 7 == 0) w->Write("%s\n", std::string(i % 50, 'x').c_str());
+      if (i % 10 == 0) w->Indent();
+      if (i % 10 == 9) w->Dedent();
+    }
+  }
+  ASSERT_RESULT_OK(sink.Flush());
+
+  std::string contents;
+  ASSERT_TRUE(android::base::ReadFileToString(file.path, &contents));
+  EXPECT_EQ(contents, expected.Code());
+}
+
+TEST(SyspropTest, CodeWriterFdSinkErrorTest) {
+  TemporaryFile file;
+  int fd = open(file.path, O_RDONLY | O_CLOEXEC);
+  ASSERT_NE(fd, -1);
+
+  FdCodeSink sink(fd, 16);
+  sink.Append("more than sixteen bytes");
+  sink.Append("dropped");
+  auto res = sink.Flush();
+  close(fd);
+
+  ASSERT_FALSE(res.ok());
+  EXPECT_EQ(res.error().code(), EBADF);
+}
+
+TEST(SyspropTest, WriteGeneratedFileIfChangedTest) {
+  TemporaryDir temp_dir;
+  std::string path = temp_dir.path + "/Generated.java"s;
+  auto generate = [](const char* name) {
+    return [name](CodeSink* sink) {
+      CodeWriter writer(kIndent, sink);
+      writer.Write("class %s {\n", name);
+      writer.Indent();
+      writer.Write("int x;\n");
+      writer.Dedent();
+      writer.Write("}\n");
+    };
+  };
+
+  auto res = WriteGeneratedFileIfChanged(path, generate("A"));
+  ASSERT_RESULT_OK(res);
+  EXPECT_TRUE(*res);
+
+  std::string contents;
+  ASSERT_TRUE(android::base::ReadFileToString(path, &contents));
+  EXPECT_EQ(contents, "class A {\n    int x;\n}\n");
+
+  struct stat before;
+  ASSERT_EQ(stat(path.c_str(), &before), 0);
+
+  res = WriteGeneratedFileIfChanged(path, generate("A"));
+  ASSERT_RESULT_OK(res);
+  EXPECT_FALSE(*res);
+
+  struct stat after;
+  ASSERT_EQ(stat(path.c_str(), &after), 0);
+  EXPECT_EQ(before.st_ino, after.st_ino);
+
+  res = WriteGeneratedFileIfChanged(path, generate("B"));
+  ASSERT_RESULT_OK(res);
+  EXPECT_TRUE(*res);
+  ASSERT_TRUE(android::base::ReadFileToString(path, &contents));
+  EXPECT_EQ(contents, "class B {\n    int x;\n}\n");
+
+  // No temporary file is left behind.
+  size_t num_files = 0;
+  for ([[maybe_unused]] auto& entry :
+       std::filesystem::directory_iterator(temp_dir.path)) {
+    ++num_files;
+  }
+  EXPECT_EQ(num_files, 1);
+}
@@ -16,13 +16,17 @@
 
 #include <unistd.h>
 #include <string>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/scopeguard.h>
 #include <android-base/test_utils.h>
 #include <gtest/gtest.h>
 
+#include "Common.h"
 #include "CppGen.h"
+#include "ResolvedProps.h"
+#include "TestInputs.h"
 
 namespace {
 
@@ -497,6 +501,8 @@ bool el(const std::vector<std::optional<el_values>>& value) {
 
 }  // namespace
 
+const char* const kCppGenTestSyspropFile = kTestSyspropFile;
+
 using namespace std::string_literals;
 
 TEST(SyspropTest, CppGenTest) {
@@ -541,3 +547,76 @@ TEST(SyspropTest, CppGenTest) {
                                               &source_output, true));
   EXPECT_EQ(source_output, kExpectedSourceOutput);
 }
+
+TEST(SyspropTest, CppGenInMemoryTest) {
+  auto props = ParsePropsFromString(kTestSyspropFile);
+  ASSERT_RESULT_OK(props);
+
+  EXPECT_EQ(GenerateHeader(*props, sysprop::Internal), kExpectedHeaderOutput);
+  EXPECT_EQ(GenerateHeader(*props, sysprop::Public),
+            kExpectedPublicHeaderOutput);
+  EXPECT_EQ(GenerateSource(*props, "properties/PlatformProperties.sysprop.h"),
+            kExpectedSourceOutput);
+}
+
+TEST(SyspropTest, CppOutputPathsTest) {
+  // A single input may put its header and source in the same directory.
+  std::vector<std::string> paths =
+      GetCppOutputPaths("Foo.sysprop", "out", "out/public", "out");
+  EXPECT_EQ(paths, (std::vector<std::string>{"out/Foo.sysprop.h",
+                                             "out/public/Foo.sysprop.h",
+                                             "out/Foo.sysprop.cpp"}));
+  EXPECT_RESULT_OK(CheckDistinctOutputPaths(paths));
+
+  // Inputs sharing a base name collide only in the dirs they share.
+  std::vector<std::string> other =
+      GetCppOutputPaths("Foo.sysprop", "other", "other/public", "other");
+  paths.insert(paths.end(), other.begin(), other.end());
+  EXPECT_RESULT_OK(CheckDistinctOutputPaths(paths));
+
+  other = GetCppOutputPaths("Foo.sysprop", "other2", "other2/public", "out");
+  paths.insert(paths.end(), other.begin(), other.end());
+  auto res = CheckDistinctOutputPaths(paths);
+  ASSERT_FALSE(res.ok());
+  EXPECT_EQ(res.error().message(),
+            "out/Foo.sysprop.cpp would be generated more than once");
+}
+
+TEST(SyspropTest, ResolvePropsTest) {
+  auto props = ParsePropsFromString(kTestSyspropFile);
+  ASSERT_RESULT_OK(props);
+
+  ResolvedProps resolved = ResolveProps(*props);
+  EXPECT_EQ(resolved.props, &*props);
+  ASSERT_EQ(resolved.properties.size(), props->prop_size());
+
+  const ResolvedProperty& long_prop = resolved.properties[5];
+  EXPECT_EQ(long_prop.prop, &props->prop(5));
+  EXPECT_EQ(long_prop.identifier, "android_os_test_long");
+  EXPECT_EQ(long_prop.type, sysprop::Long);
+  EXPECT_EQ(long_prop.scope, sysprop::Public);
+  EXPECT_FALSE(long_prop.is_list);
+  EXPECT_FALSE(long_prop.is_enum);
+  EXPECT_TRUE(long_prop.writable);
+  EXPECT_FALSE(long_prop.deprecated);
+  EXPECT_TRUE(long_prop.enum_type_name.empty());
+  EXPECT_TRUE(long_prop.enum_values.empty());
+
+  const ResolvedProperty& enum_list = resolved.properties[9];
+  EXPECT_EQ(enum_list.identifier, "el");
+  EXPECT_EQ(enum_list.enum_type_name, "el_values");
+  EXPECT_TRUE(enum_list.is_list);
+  EXPECT_TRUE(enum_list.is_enum);
+  EXPECT_TRUE(enum_list.deprecated);
+  ASSERT_EQ(enum_list.enum_values.size(), 3);
+  EXPECT_EQ(enum_list.enum_values[0].name, "enu");
+  EXPECT_EQ(enum_list.enum_values[0].upper_name, "ENU");
+  EXPECT_EQ(enum_list.enum_values[2].name, "lue");
+  EXPECT_EQ(enum_list.enum_values[2].upper_name, "LUE");
+
+  EXPECT_EQ(GenerateHeader(resolved, sysprop::Internal), kExpectedHeaderOutput);
+  EXPECT_EQ(GenerateHeader(resolved, sysprop::Public),
+            kExpectedPublicHeaderOutput);
+  EXPECT_EQ(GenerateSource(resolved, "properties/PlatformProperties.sysprop.h"),
+            kExpectedSourceOutput);
+}
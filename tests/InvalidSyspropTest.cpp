@@ -16,12 +16,14 @@
 
 #include <cstdio>
 #include <string>
+#include <vector>
 
 #include <android-base/file.h>
 #include <android-base/test_utils.h>
 #include <gtest/gtest.h>
 
 #include "Common.h"
+#include "TestInputs.h"
 #include "sysprop.pb.h"
 
 namespace {
@@ -195,6 +197,14 @@ constexpr const char* kTestCasesAndExpectedErrors[][2] = {
 
 }  // namespace
 
+std::vector<const char*> GetInvalidSyspropTestInputs() {
+  std::vector<const char*> ret;
+  for (const auto& test_case : kTestCasesAndExpectedErrors) {
+    ret.push_back(test_case[0]);
+  }
+  return ret;
+}
+
 TEST(SyspropTest, InvalidSyspropTest) {
   TemporaryFile file;
   close(file.fd);
@@ -21,7 +21,9 @@
 #include <android-base/test_utils.h>
 #include <gtest/gtest.h>
 
+#include "Common.h"
 #include "JavaGen.h"
+#include "TestInputs.h"
 
 namespace {
 
@@ -534,10 +536,1617 @@ public final class TestProperties {
 }
 )s";
 
-}  // namespace
+constexpr const char* kExpectedLambdaFreeInternalOutput =
+    R"s(// Generated by the sysprop generator. DO NOT EDIT!
+
+package com.somecompany;
+
+import android.os.SystemProperties;
+
+import java.lang.StringBuilder;
+import java.util.ArrayList;
+import java.util.List;
+import java.util.Locale;
+import java.util.Optional;
+import java.util.StringJoiner;
+
+public final class TestProperties {
+    private TestProperties () {}
+
+    private static Boolean tryParseBoolean(String str) {
+        switch (str.toLowerCase(Locale.US)) {
+            case "1":
+            case "true":
+                return Boolean.TRUE;
+            case "0":
+            case "false":
+                return Boolean.FALSE;
+            default:
+                return null;
+        }
+    }
+
+    private static Integer tryParseInteger(String str) {
+        try {
+            return Integer.valueOf(str);
+        } catch (NumberFormatException e) {
+            return null;
+        }
+    }
+
+    private static Long tryParseLong(String str) {
+        try {
+            return Long.valueOf(str);
+        } catch (NumberFormatException e) {
+            return null;
+        }
+    }
+
+    private static Double tryParseDouble(String str) {
+        try {
+            return Double.valueOf(str);
+        } catch (NumberFormatException e) {
+            return null;
+        }
+    }
+
+    private static String tryParseString(String str) {
+        return "".equals(str) ? null : str;
+    }
+
+    private static <T extends Enum<T>> T tryParseEnum(Class<T> enumType, String str) {
+        try {
+            return Enum.valueOf(enumType, str.toUpperCase(Locale.US));
+        } catch (IllegalArgumentException e) {
+            return null;
+        }
+    }
+
+    private static int findListElementEnd(String str, int p) {
+        while (p < str.length() && str.charAt(p) != ',') {
+            if (str.charAt(p) == '\\') ++p;
+            ++p;
+        }
+        return Math.min(p, str.length());
+    }
+
+    private static String getListElement(String str, int begin, int end) {
+        String element = str.substring(begin, end);
+        if (element.indexOf('\\') < 0) return element;
+
+        StringBuilder sb = new StringBuilder(element.length());
+        for (int p = 0; p < element.length(); ++p) {
+            if (element.charAt(p) == '\\' && ++p == element.length()) break;
+            sb.append(element.charAt(p));
+        }
+        return sb.toString();
+    }
+
+    private static List<Boolean> tryParseBooleanList(String str) {
+        List<Boolean> ret = new ArrayList<>();
+        if ("".equals(str)) return ret;
+
+        int p = 0;
+        for (;;) {
+            int end = findListElementEnd(str, p);
+            ret.add(tryParseBoolean(getListElement(str, p, end)));
+            if (end == str.length()) break;
+            p = end + 1;
+        }
+
+        return ret;
+    }
+
+    private static List<Integer> tryParseIntegerList(String str) {
+        List<Integer> ret = new ArrayList<>();
+        if ("".equals(str)) return ret;
+
+        int p = 0;
+        for (;;) {
+            int end = findListElementEnd(str, p);
+            ret.add(tryParseInteger(getListElement(str, p, end)));
+            if (end == str.length()) break;
+            p = end + 1;
+        }
+
+        return ret;
+    }
+
+    private static List<Long> tryParseLongList(String str) {
+        List<Long> ret = new ArrayList<>();
+        if ("".equals(str)) return ret;
+
+        int p = 0;
+        for (;;) {
+            int end = findListElementEnd(str, p);
+            ret.add(tryParseLong(getListElement(str, p, end)));
+            if (end == str.length()) break;
+            p = end + 1;
+        }
+
+        return ret;
+    }
+
+    private static List<Double> tryParseDoubleList(String str) {
+        List<Double> ret = new ArrayList<>();
+        if ("".equals(str)) return ret;
+
+        int p = 0;
+        for (;;) {
+            int end = findListElementEnd(str, p);
+            ret.add(tryParseDouble(getListElement(str, p, end)));
+            if (end == str.length()) break;
+            p = end + 1;
+        }
+
+        return ret;
+    }
+
+    private static List<String> tryParseStringList(String str) {
+        List<String> ret = new ArrayList<>();
+        if ("".equals(str)) return ret;
+
+        int p = 0;
+        for (;;) {
+            int end = findListElementEnd(str, p);
+            ret.add(tryParseString(getListElement(str, p, end)));
+            if (end == str.length()) break;
+            p = end + 1;
+        }
+
+        return ret;
+    }
+
+    private static <T extends Enum<T>> List<T> tryParseEnumList(Class<T> enumType, String str) {
+        if ("".equals(str)) return new ArrayList<>();
+
+        List<T> ret = new ArrayList<>();
+
+        for (String element : str.split(",")) {
+            ret.add(tryParseEnum(enumType, element));
+        }
+
+        return ret;
+    }
+
+    private static String escape(String str) {
+        if (str.indexOf('\\') < 0 && str.indexOf(',') < 0) return str;
+
+        StringBuilder sb = new StringBuilder(str.length() + 8);
+        for (int i = 0; i < str.length(); ++i) {
+            char c = str.charAt(i);
+            if (c == '\\' || c == ',') sb.append('\\');
+            sb.append(c);
+        }
+        return sb.toString();
+    }
+
+    private static <T> String formatList(List<T> list) {
+        StringJoiner joiner = new StringJoiner(",");
+
+        for (T element : list) {
+            joiner.add(element == null ? "" : escape(element.toString()));
+        }
+
+        return joiner.toString();
+    }
+
+    private static String formatIntegerAsBoolList(List<Boolean> list) {
+        StringJoiner joiner = new StringJoiner(",");
+
+        for (Boolean element : list) {
+            joiner.add(element == null ? "" : (element ? "1" : "0"));
+        }
+
+        return joiner.toString();
+    }
+
+    public static Optional<Double> test_double() {
+        String value = SystemProperties.get("vendor.test_double");
+        return Optional.ofNullable(tryParseDouble(value));
+    }
+
+    public static void test_double(Double value) {
+        SystemProperties.set("vendor.test_double", value == null ? "" : value.toString());
+    }
+
+    public static Optional<Integer> test_int() {
+        String value = SystemProperties.get("vendor.test_int");
+        return Optional.ofNullable(tryParseInteger(value));
+    }
+
+    public static void test_int(Integer value) {
+        SystemProperties.set("vendor.test_int", value == null ? "" : value.toString());
+    }
+
+    public static Optional<String> test_string() {
+        String value = SystemProperties.get("vendor.test.string");
+        return Optional.ofNullable(tryParseString(value));
+    }
+
+    public static void test_string(String value) {
+        SystemProperties.set("vendor.test.string", value == null ? "" : value.toString());
+    }
+
+    public static enum test_enum_values {
+        A("a"),
+        B("b"),
+        C("c"),
+        D("D"),
+        E("e"),
+        F("f"),
+        G("G");
+        private final String propValue;
+        private test_enum_values(String propValue) {
+            this.propValue = propValue;
+        }
+        public String getPropValue() {
+            return propValue;
+        }
+    }
+
+    public static Optional<test_enum_values> test_enum() {
+        String value = SystemProperties.get("vendor.test.enum");
+        return Optional.ofNullable(tryParseEnum(test_enum_values.class, value));
+    }
+
+    public static void test_enum(test_enum_values value) {
+        SystemProperties.set("vendor.test.enum", value == null ? "" : value.getPropValue());
+    }
+
+    public static Optional<Boolean> test_BOOLeaN() {
+        String value = SystemProperties.get("ro.vendor.test.b");
+        return Optional.ofNullable(tryParseBoolean(value));
+    }
+
+    public static void test_BOOLeaN(Boolean value) {
+        SystemProperties.set("ro.vendor.test.b", value == null ? "" : value.toString());
+    }
+
+    public static Optional<Long> vendor_os_test_long() {
+        String value = SystemProperties.get("vendor.vendor_os_test-long");
+        return Optional.ofNullable(tryParseLong(value));
+    }
+
+    public static void vendor_os_test_long(Long value) {
+        SystemProperties.set("vendor.vendor_os_test-long", value == null ? "" : value.toString());
+    }
+
+    public static List<Double> test_double_list() {
+        String value = SystemProperties.get("vendor.test_double_list");
+        return tryParseDoubleList(value);
+    }
+
+    public static void test_double_list(List<Double> value) {
+        SystemProperties.set("vendor.test_double_list", value == null ? "" : formatList(value));
+    }
+
+    public static List<Integer> test_list_int() {
+        String value = SystemProperties.get("vendor.test_list_int");
+        return tryParseIntegerList(value);
+    }
+
+    public static void test_list_int(List<Integer> value) {
+        SystemProperties.set("vendor.test_list_int", value == null ? "" : formatList(value));
+    }
+
+    @Deprecated
+    public static List<String> test_strlist() {
+        String value = SystemProperties.get("vendor.test_strlist");
+        return tryParseStringList(value);
+    }
+
+    @Deprecated
+    public static void test_strlist(List<String> value) {
+        SystemProperties.set("vendor.test_strlist", value == null ? "" : formatList(value));
+    }
+
+    public static enum el_values {
+        ENU("enu"),
+        MVA("mva"),
+        LUE("lue");
+        private final String propValue;
+        private el_values(String propValue) {
+            this.propValue = propValue;
+        }
+        public String getPropValue() {
+            return propValue;
+        }
+    }
+
+    private static String formatList_el_values(List<el_values> list) {
+        StringJoiner joiner = new StringJoiner(",");
+
+        for (el_values element : list) {
+            joiner.add(element == null ? "" : element.getPropValue());
+        }
+
+        return joiner.toString();
+    }
+
+    @Deprecated
+    public static List<el_values> el() {
+        String value = SystemProperties.get("vendor.el");
+        return tryParseEnumList(el_values.class, value);
+    }
+
+    @Deprecated
+    public static void el(List<el_values> value) {
+        SystemProperties.set("vendor.el", value == null ? "" : formatList_el_values(value));
+    }
+}
+)s";
+
+constexpr const char* kExpectedPrimitiveArraysInternalOutput =
+    R"s(// Generated by the sysprop generator. DO NOT EDIT!
+
+package com.somecompany;
+
+import android.os.SystemProperties;
+
+import java.lang.StringBuilder;
+import java.util.ArrayList;
+import java.util.BitSet;
+import java.util.function.Function;
+import java.util.List;
+import java.util.Locale;
+import java.util.Optional;
+import java.util.StringJoiner;
+import java.util.stream.Collectors;
+
+public final class TestProperties {
+    private TestProperties () {}
+
+    private static Boolean tryParseBoolean(String str) {
+        switch (str.toLowerCase(Locale.US)) {
+            case "1":
+            case "true":
+                return Boolean.TRUE;
+            case "0":
+            case "false":
+                return Boolean.FALSE;
+            default:
+                return null;
+        }
+    }
+
+    private static Integer tryParseInteger(String str) {
+        try {
+            return Integer.valueOf(str);
+        } catch (NumberFormatException e) {
+            return null;
+        }
+    }
+
+    private static Long tryParseLong(String str) {
+        try {
+            return Long.valueOf(str);
+        } catch (NumberFormatException e) {
+            return null;
+        }
+    }
+
+    private static Double tryParseDouble(String str) {
+        try {
+            return Double.valueOf(str);
+        } catch (NumberFormatException e) {
+            return null;
+        }
+    }
+
+    private static String tryParseString(String str) {
+        return "".equals(str) ? null : str;
+    }
+
+    private static <T extends Enum<T>> T tryParseEnum(Class<T> enumType, String str) {
+        try {
+            return Enum.valueOf(enumType, str.toUpperCase(Locale.US));
+        } catch (IllegalArgumentException e) {
+            return null;
+        }
+    }
+
+    private static int findListElementEnd(String str, int p) {
+        while (p < str.length() && str.charAt(p) != ',') {
+            if (str.charAt(p) == '\\') ++p;
+            ++p;
+        }
+        return Math.min(p, str.length());
+    }
+
+    private static String getListElement(String str, int begin, int end) {
+        String element = str.substring(begin, end);
+        if (element.indexOf('\\') < 0) return element;
+
+        StringBuilder sb = new StringBuilder(element.length());
+        for (int p = 0; p < element.length(); ++p) {
+            if (element.charAt(p) == '\\' && ++p == element.length()) break;
+            sb.append(element.charAt(p));
+        }
+        return sb.toString();
+    }
+
+    private static <T> List<T> tryParseList(Function<String, T> elementParser, String str) {
+        if ("".equals(str)) return new ArrayList<>();
+
+        List<T> ret = new ArrayList<>();
+
+        int p = 0;
+        for (;;) {
+            StringBuilder sb = new StringBuilder();
+            while (p < str.length() && str.charAt(p) != ',') {
+                if (str.charAt(p) == '\\') ++p;
+                if (p == str.length()) break;
+                sb.append(str.charAt(p++));
+            }
+            ret.add(elementParser.apply(sb.toString()));
+            if (p == str.length()) break;
+            ++p;
+        }
+
+        return ret;
+    }
+
+    private static <T extends Enum<T>> List<T> tryParseEnumList(Class<T> enumType, String str) {
+        if ("".equals(str)) return new ArrayList<>();
+
+        List<T> ret = new ArrayList<>();
+
+        for (String element : str.split(",")) {
+            ret.add(tryParseEnum(enumType, element));
+        }
+
+        return ret;
+    }
+
+    private static String escape(String str) {
+        return str.replaceAll("([\\\\,])", "\\\\$1");
+    }
+
+    private static <T> String formatList(List<T> list) {
+        StringJoiner joiner = new StringJoiner(",");
+
+        for (T element : list) {
+            joiner.add(element == null ? "" : escape(element.toString()));
+        }
+
+        return joiner.toString();
+    }
+
+    private static <T extends Enum<T>> String formatEnumList(List<T> list, Function<T, String> elementFormatter) {
+        StringJoiner joiner = new StringJoiner(",");
+
+        for (T element : list) {
+            joiner.add(element == null ? "" : elementFormatter.apply(element));
+        }
+
+        return joiner.toString();
+    }
+
+    private static int countListElements(String str) {
+        if ("".equals(str)) return 0;
+
+        int n = 1;
+        for (int p = 0; p < str.length(); ++p) {
+            char c = str.charAt(p);
+            if (c == '\\') {
+                ++p;
+            } else if (c == ',') {
+                ++n;
+            }
+        }
+        return n;
+    }
+
+    private static boolean[] tryParseBooleanArray(String str, BitSet valid) {
+        boolean[] ret = new boolean[countListElements(str)];
+        if (valid != null) valid.clear();
+
+        int p = 0;
+        for (int i = 0; i < ret.length; ++i) {
+            int end = findListElementEnd(str, p);
+            String element = getListElement(str, p, end);
+            if ("1".equals(element) || "true".equalsIgnoreCase(element)) {
+                ret[i] = true;
+                if (valid != null) valid.set(i);
+            } else if ("0".equals(element) || "false".equalsIgnoreCase(element)) {
+                if (valid != null) valid.set(i);
+            }
+            p = end + 1;
+        }
+
+        return ret;
+    }
+
+    private static int[] tryParseIntegerArray(String str, BitSet valid) {
+        int[] ret = new int[countListElements(str)];
+        if (valid != null) valid.clear();
+
+        int p = 0;
+        for (int i = 0; i < ret.length; ++i) {
+            int end = findListElementEnd(str, p);
+            try {
+                ret[i] = Integer.parseInt(getListElement(str, p, end));
+                if (valid != null) valid.set(i);
+            } catch (NumberFormatException e) {
+            }
+            p = end + 1;
+        }
+
+        return ret;
+    }
+
+    private static long[] tryParseLongArray(String str, BitSet valid) {
+        long[] ret = new long[countListElements(str)];
+        if (valid != null) valid.clear();
+
+        int p = 0;
+        for (int i = 0; i < ret.length; ++i) {
+            int end = findListElementEnd(str, p);
+            try {
+                ret[i] = Long.parseLong(getListElement(str, p, end));
+                if (valid != null) valid.set(i);
+            } catch (NumberFormatException e) {
+            }
+            p = end + 1;
+        }
+
+        return ret;
+    }
+
+    private static double[] tryParseDoubleArray(String str, BitSet valid) {
+        double[] ret = new double[countListElements(str)];
+        if (valid != null) valid.clear();
+
+        int p = 0;
+        for (int i = 0; i < ret.length; ++i) {
+            int end = findListElementEnd(str, p);
+            try {
+                ret[i] = Double.parseDouble(getListElement(str, p, end));
+                if (valid != null) valid.set(i);
+            } catch (NumberFormatException e) {
+            }
+            p = end + 1;
+        }
+
+        return ret;
+    }
+
+    private static String formatArray(boolean[] array) {
+        StringBuilder sb = new StringBuilder();
+        for (int i = 0; i < array.length; ++i) {
+            if (i > 0) sb.append(',');
+            sb.append(array[i]);
+        }
+        return sb.toString();
+    }
+
+    private static String formatIntegerAsBoolArray(boolean[] array) {
+        StringBuilder sb = new StringBuilder();
+        for (int i = 0; i < array.length; ++i) {
+            if (i > 0) sb.append(',');
+            sb.append(array[i] ? '1' : '0');
+        }
+        return sb.toString();
+    }
+
+    private static String formatArray(int[] array) {
+        StringBuilder sb = new StringBuilder();
+        for (int i = 0; i < array.length; ++i) {
+            if (i > 0) sb.append(',');
+            sb.append(array[i]);
+        }
+        return sb.toString();
+    }
+
+    private static String formatArray(long[] array) {
+        StringBuilder sb = new StringBuilder();
+        for (int i = 0; i < array.length; ++i) {
+            if (i > 0) sb.append(',');
+            sb.append(array[i]);
+        }
+        return sb.toString();
+    }
+
+    private static String formatArray(double[] array) {
+        StringBuilder sb = new StringBuilder();
+        for (int i = 0; i < array.length; ++i) {
+            if (i > 0) sb.append(',');
+            sb.append(array[i]);
+        }
+        return sb.toString();
+    }
+
+    public static Optional<Double> test_double() {
+        String value = SystemProperties.get("vendor.test_double");
+        return Optional.ofNullable(tryParseDouble(value));
+    }
+
+    public static void test_double(Double value) {
+        SystemProperties.set("vendor.test_double", value == null ? "" : value.toString());
+    }
+
+    public static Optional<Integer> test_int() {
+        String value = SystemProperties.get("vendor.test_int");
+        return Optional.ofNullable(tryParseInteger(value));
+    }
+
+    public static void test_int(Integer value) {
+        SystemProperties.set("vendor.test_int", value == null ? "" : value.toString());
+    }
+
+    public static Optional<String> test_string() {
+        String value = SystemProperties.get("vendor.test.string");
+        return Optional.ofNullable(tryParseString(value));
+    }
+
+    public static void test_string(String value) {
+        SystemProperties.set("vendor.test.string", value == null ? "" : value.toString());
+    }
+
+    public static enum test_enum_values {
+        A("a"),
+        B("b"),
+        C("c"),
+        D("D"),
+        E("e"),
+        F("f"),
+        G("G");
+        private final String propValue;
+        private test_enum_values(String propValue) {
+            this.propValue = propValue;
+        }
+        public String getPropValue() {
+            return propValue;
+        }
+    }
+
+    public static Optional<test_enum_values> test_enum() {
+        String value = SystemProperties.get("vendor.test.enum");
+        return Optional.ofNullable(tryParseEnum(test_enum_values.class, value));
+    }
+
+    public static void test_enum(test_enum_values value) {
+        SystemProperties.set("vendor.test.enum", value == null ? "" : value.getPropValue());
+    }
+
+    public static Optional<Boolean> test_BOOLeaN() {
+        String value = SystemProperties.get("ro.vendor.test.b");
+        return Optional.ofNullable(tryParseBoolean(value));
+    }
+
+    public static void test_BOOLeaN(Boolean value) {
+        SystemProperties.set("ro.vendor.test.b", value == null ? "" : value.toString());
+    }
+
+    public static Optional<Long> vendor_os_test_long() {
+        String value = SystemProperties.get("vendor.vendor_os_test-long");
+        return Optional.ofNullable(tryParseLong(value));
+    }
+
+    public static void vendor_os_test_long(Long value) {
+        SystemProperties.set("vendor.vendor_os_test-long", value == null ? "" : value.toString());
+    }
+
+    public static List<Double> test_double_list() {
+        String value = SystemProperties.get("vendor.test_double_list");
+        return tryParseList(v -> tryParseDouble(v), value);
+    }
+
+    public static void test_double_list(List<Double> value) {
+        SystemProperties.set("vendor.test_double_list", value == null ? "" : formatList(value));
+    }
+
+    public static double[] test_double_list_array() {
+        return test_double_list_array((BitSet) null);
+    }
+
+    public static double[] test_double_list_array(BitSet valid) {
+        String value = SystemProperties.get("vendor.test_double_list");
+        return tryParseDoubleArray(value, valid);
+    }
+
+    public static void test_double_list_array(double[] value) {
+        SystemProperties.set("vendor.test_double_list", value == null ? "" : formatArray(value));
+    }
+
+    public static List<Integer> test_list_int() {
+        String value = SystemProperties.get("vendor.test_list_int");
+        return tryParseList(v -> tryParseInteger(v), value);
+    }
+
+    public static void test_list_int(List<Integer> value) {
+        SystemProperties.set("vendor.test_list_int", value == null ? "" : formatList(value));
+    }
+
+    public static int[] test_list_int_array() {
+        return test_list_int_array((BitSet) null);
+    }
+
+    public static int[] test_list_int_array(BitSet valid) {
+        String value = SystemProperties.get("vendor.test_list_int");
+        return tryParseIntegerArray(value, valid);
+    }
+
+    public static void test_list_int_array(int[] value) {
+        SystemProperties.set("vendor.test_list_int", value == null ? "" : formatArray(value));
+    }
+
+    @Deprecated
+    public static List<String> test_strlist() {
+        String value = SystemProperties.get("vendor.test_strlist");
+        return tryParseList(v -> tryParseString(v), value);
+    }
+
+    @Deprecated
+    public static void test_strlist(List<String> value) {
+        SystemProperties.set("vendor.test_strlist", value == null ? "" : formatList(value));
+    }
+
+    public static enum el_values {
+        ENU("enu"),
+        MVA("mva"),
+        LUE("lue");
+        private final String propValue;
+        private el_values(String propValue) {
+            this.propValue = propValue;
+        }
+        public String getPropValue() {
+            return propValue;
+        }
+    }
+
+    @Deprecated
+    public static List<el_values> el() {
+        String value = SystemProperties.get("vendor.el");
+        return tryParseEnumList(el_values.class, value);
+    }
+
+    @Deprecated
+    public static void el(List<el_values> value) {
+        SystemProperties.set("vendor.el", value == null ? "" : formatEnumList(value, el_values::getPropValue));
+    }
+}
+)s";
+
+constexpr const char* kExpectedChangeCallbacksPublicOutput =
+    R"s(// Generated by the sysprop generator. DO NOT EDIT!
+
+package com.somecompany;
+
+import android.os.SystemProperties;
+
+import java.lang.StringBuilder;
+import java.util.ArrayDeque;
+import java.util.ArrayList;
+import java.util.function.Function;
+import java.util.List;
+import java.util.Locale;
+import java.util.Optional;
+import java.util.StringJoiner;
+import java.util.stream.Collectors;
+
+public final class TestProperties {
+    private TestProperties () {}
+
+    private static Boolean tryParseBoolean(String str) {
+        switch (str.toLowerCase(Locale.US)) {
+            case "1":
+            case "true":
+                return Boolean.TRUE;
+            case "0":
+            case "false":
+                return Boolean.FALSE;
+            default:
+                return null;
+        }
+    }
+
+    private static Integer tryParseInteger(String str) {
+        try {
+            return Integer.valueOf(str);
+        } catch (NumberFormatException e) {
+            return null;
+        }
+    }
+
+    private static Long tryParseLong(String str) {
+        try {
+            return Long.valueOf(str);
+        } catch (NumberFormatException e) {
+            return null;
+        }
+    }
+
+    private static Double tryParseDouble(String str) {
+        try {
+            return Double.valueOf(str);
+        } catch (NumberFormatException e) {
+            return null;
+        }
+    }
+
+    private static String tryParseString(String str) {
+        return "".equals(str) ? null : str;
+    }
+
+    private static <T extends Enum<T>> T tryParseEnum(Class<T> enumType, String str) {
+        try {
+            return Enum.valueOf(enumType, str.toUpperCase(Locale.US));
+        } catch (IllegalArgumentException e) {
+            return null;
+        }
+    }
+
+    private static <T> List<T> tryParseList(Function<String, T> elementParser, String str) {
+        if ("".equals(str)) return new ArrayList<>();
+
+        List<T> ret = new ArrayList<>();
+
+        int p = 0;
+        for (;;) {
+            StringBuilder sb = new StringBuilder();
+            while (p < str.length() && str.charAt(p) != ',') {
+                if (str.charAt(p) == '\\') ++p;
+                if (p == str.length()) break;
+                sb.append(str.charAt(p++));
+            }
+            ret.add(elementParser.apply(sb.toString()));
+            if (p == str.length()) break;
+            ++p;
+        }
+
+        return ret;
+    }
+
+    private static <T extends Enum<T>> List<T> tryParseEnumList(Class<T> enumType, String str) {
+        if ("".equals(str)) return new ArrayList<>();
+
+        List<T> ret = new ArrayList<>();
+
+        for (String element : str.split(",")) {
+            ret.add(tryParseEnum(enumType, element));
+        }
+
+        return ret;
+    }
+
+    private static String escape(String str) {
+        return str.replaceAll("([\\\\,])", "\\\\$1");
+    }
+
+    private static <T> String formatList(List<T> list) {
+        StringJoiner joiner = new StringJoiner(",");
+
+        for (T element : list) {
+            joiner.add(element == null ? "" : escape(element.toString()));
+        }
+
+        return joiner.toString();
+    }
+
+    private static <T extends Enum<T>> String formatEnumList(List<T> list, Function<T, String> elementFormatter) {
+        StringJoiner joiner = new StringJoiner(",");
+
+        for (T element : list) {
+            joiner.add(element == null ? "" : elementFormatter.apply(element));
+        }
+
+        return joiner.toString();
+    }
+
+    private static final Object sChangeCallbackLock = new Object();
+    private static boolean sChangeCallbackRegistered = false;
+
+    private static void registerChangeCallbackLocked() {
+        if (sChangeCallbackRegistered) return;
+        sChangeCallbackRegistered = true;
+        SystemProperties.addChangeCallback(new Runnable() {
+            @Override
+            public void run() {
+                onSystemPropertiesChanged();
+            }
+        });
+    }
+
+    // Callbacks may run on the thread reporting system property changes, with
+    // no lock held. A prop's values are delivered one at a time, in the order
+    // they were read.
+    public interface ChangeCallback<T> {
+        void onChange(T value);
+    }
+
+    public static Optional<Integer> test_int() {
+        String value = SystemProperties.get("vendor.test_int");
+        return Optional.ofNullable(tryParseInteger(value));
+    }
+
+    public static void test_int(Integer value) {
+        SystemProperties.set("vendor.test_int", value == null ? "" : value.toString());
+    }
+
+    private static final ArrayList<ChangeCallback<Optional<Integer>>> test_int_changeCallbacks = new ArrayList<>();
+    private static Optional<Integer> test_int_lastValue;
+    private static final ArrayDeque<Optional<Integer>> test_int_pendingValues = new ArrayDeque<>();
+    private static boolean test_int_dispatching;
+
+    public static void test_int_addChangeCallback(ChangeCallback<Optional<Integer>> callback) {
+        synchronized (sChangeCallbackLock) {
+            if (test_int_changeCallbacks.isEmpty()) test_int_lastValue = test_int();
+            test_int_changeCallbacks.add(callback);
+            registerChangeCallbackLocked();
+        }
+    }
+
+    public static void test_int_removeChangeCallback(ChangeCallback<Optional<Integer>> callback) {
+        synchronized (sChangeCallbackLock) {
+            test_int_changeCallbacks.remove(callback);
+        }
+    }
+
+    private static void test_int_dispatchChange() {
+        synchronized (sChangeCallbackLock) {
+            if (test_int_changeCallbacks.isEmpty()) return;
+            Optional<Integer> value = test_int();
+            if (value.equals(test_int_lastValue)) return;
+            test_int_lastValue = value;
+            test_int_pendingValues.add(value);
+            if (test_int_dispatching) return;
+            test_int_dispatching = true;
+        }
+        boolean drained = false;
+        try {
+            for (;;) {
+                Optional<Integer> value;
+                ArrayList<ChangeCallback<Optional<Integer>>> callbacks;
+                synchronized (sChangeCallbackLock) {
+                    value = test_int_pendingValues.poll();
+                    if (value == null) {
+                        test_int_dispatching = false;
+                        drained = true;
+                        return;
+                    }
+                    callbacks = new ArrayList<>(test_int_changeCallbacks);
+                }
+                for (int i = 0; i < callbacks.size(); ++i) {
+                    callbacks.get(i).onChange(value);
+                }
+            }
+        } finally {
+            if (!drained) {
+                synchronized (sChangeCallbackLock) {
+                    test_int_pendingValues.clear();
+                    test_int_dispatching = false;
+                }
+            }
+        }
+    }
+
+    public static Optional<String> test_string() {
+        String value = SystemProperties.get("vendor.test.string");
+        return Optional.ofNullable(tryParseString(value));
+    }
+
+    public static void test_string(String value) {
+        SystemProperties.set("vendor.test.string", value == null ? "" : value.toString());
+    }
+
+    private static final ArrayList<ChangeCallback<Optional<String>>> test_string_changeCallbacks = new ArrayList<>();
+    private static Optional<String> test_string_lastValue;
+    private static final ArrayDeque<Optional<String>> test_string_pendingValues = new ArrayDeque<>();
+    private static boolean test_string_dispatching;
+
+    public static void test_string_addChangeCallback(ChangeCallback<Optional<String>> callback) {
+        synchronized (sChangeCallbackLock) {
+            if (test_string_changeCallbacks.isEmpty()) test_string_lastValue = test_string();
+            test_string_changeCallbacks.add(callback);
+            registerChangeCallbackLocked();
+        }
+    }
+
+    public static void test_string_removeChangeCallback(ChangeCallback<Optional<String>> callback) {
+        synchronized (sChangeCallbackLock) {
+            test_string_changeCallbacks.remove(callback);
+        }
+    }
+
+    private static void test_string_dispatchChange() {
+        synchronized (sChangeCallbackLock) {
+            if (test_string_changeCallbacks.isEmpty()) return;
+            Optional<String> value = test_string();
+            if (value.equals(test_string_lastValue)) return;
+            test_string_lastValue = value;
+            test_string_pendingValues.add(value);
+            if (test_string_dispatching) return;
+            test_string_dispatching = true;
+        }
+        boolean drained = false;
+        try {
+            for (;;) {
+                Optional<String> value;
+                ArrayList<ChangeCallback<Optional<String>>> callbacks;
+                synchronized (sChangeCallbackLock) {
+                    value = test_string_pendingValues.poll();
+                    if (value == null) {
+                        test_string_dispatching = false;
+                        drained = true;
+                        return;
+                    }
+                    callbacks = new ArrayList<>(test_string_changeCallbacks);
+                }
+                for (int i = 0; i < callbacks.size(); ++i) {
+                    callbacks.get(i).onChange(value);
+                }
+            }
+        } finally {
+            if (!drained) {
+                synchronized (sChangeCallbackLock) {
+                    test_string_pendingValues.clear();
+                    test_string_dispatching = false;
+                }
+            }
+        }
+    }
+
+    public static Optional<Boolean> test_BOOLeaN() {
+        String value = SystemProperties.get("ro.vendor.test.b");
+        return Optional.ofNullable(tryParseBoolean(value));
+    }
+
+    public static void test_BOOLeaN(Boolean value) {
+        SystemProperties.set("ro.vendor.test.b", value == null ? "" : value.toString());
+    }
+
+    private static final ArrayList<ChangeCallback<Optional<Boolean>>> test_BOOLeaN_changeCallbacks = new ArrayList<>();
+    private static Optional<Boolean> test_BOOLeaN_lastValue;
+    private static final ArrayDeque<Optional<Boolean>> test_BOOLeaN_pendingValues = new ArrayDeque<>();
+    private static boolean test_BOOLeaN_dispatching;
+
+    public static void test_BOOLeaN_addChangeCallback(ChangeCallback<Optional<Boolean>> callback) {
+        synchronized (sChangeCallbackLock) {
+            if (test_BOOLeaN_changeCallbacks.isEmpty()) test_BOOLeaN_lastValue = test_BOOLeaN();
+            test_BOOLeaN_changeCallbacks.add(callback);
+            registerChangeCallbackLocked();
+        }
+    }
+
+    public static void test_BOOLeaN_removeChangeCallback(ChangeCallback<Optional<Boolean>> callback) {
+        synchronized (sChangeCallbackLock) {
+            test_BOOLeaN_changeCallbacks.remove(callback);
+        }
+    }
+
+    private static void test_BOOLeaN_dispatchChange() {
+        synchronized (sChangeCallbackLock) {
+            if (test_BOOLeaN_changeCallbacks.isEmpty()) return;
+            Optional<Boolean> value = test_BOOLeaN();
+            if (value.equals(test_BOOLeaN_lastValue)) return;
+            test_BOOLeaN_lastValue = value;
+            test_BOOLeaN_pendingValues.add(value);
+            if (test_BOOLeaN_dispatching) return;
+            test_BOOLeaN_dispatching = true;
+        }
+        boolean drained = false;
+        try {
+            for (;;) {
+                Optional<Boolean> value;
+                ArrayList<ChangeCallback<Optional<Boolean>>> callbacks;
+                synchronized (sChangeCallbackLock) {
+                    value = test_BOOLeaN_pendingValues.poll();
+                    if (value == null) {
+                        test_BOOLeaN_dispatching = false;
+                        drained = true;
+                        return;
+                    }
+                    callbacks = new ArrayList<>(test_BOOLeaN_changeCallbacks);
+                }
+                for (int i = 0; i < callbacks.size(); ++i) {
+                    callbacks.get(i).onChange(value);
+                }
+            }
+        } finally {
+            if (!drained) {
+                synchronized (sChangeCallbackLock) {
+                    test_BOOLeaN_pendingValues.clear();
+                    test_BOOLeaN_dispatching = false;
+                }
+            }
+        }
+    }
+
+    public static Optional<Long> vendor_os_test_long() {
+        String value = SystemProperties.get("vendor.vendor_os_test-long");
+        return Optional.ofNullable(tryParseLong(value));
+    }
+
+    public static void vendor_os_test_long(Long value) {
+        SystemProperties.set("vendor.vendor_os_test-long", value == null ? "" : value.toString());
+    }
+
+    private static final ArrayList<ChangeCallback<Optional<Long>>> vendor_os_test_long_changeCallbacks = new ArrayList<>();
+    private static Optional<Long> vendor_os_test_long_lastValue;
+    private static final ArrayDeque<Optional<Long>> vendor_os_test_long_pendingValues = new ArrayDeque<>();
+    private static boolean vendor_os_test_long_dispatching;
+
+    public static void vendor_os_test_long_addChangeCallback(ChangeCallback<Optional<Long>> callback) {
+        synchronized (sChangeCallbackLock) {
+            if (vendor_os_test_long_changeCallbacks.isEmpty()) vendor_os_test_long_lastValue = vendor_os_test_long();
+            vendor_os_test_long_changeCallbacks.add(callback);
+            registerChangeCallbackLocked();
+        }
+    }
+
+    public static void vendor_os_test_long_removeChangeCallback(ChangeCallback<Optional<Long>> callback) {
+        synchronized (sChangeCallbackLock) {
+            vendor_os_test_long_changeCallbacks.remove(callback);
+        }
+    }
+
+    private static void vendor_os_test_long_dispatchChange() {
+        synchronized (sChangeCallbackLock) {
+            if (vendor_os_test_long_changeCallbacks.isEmpty()) return;
+            Optional<Long> value = vendor_os_test_long();
+            if (value.equals(vendor_os_test_long_lastValue)) return;
+            vendor_os_test_long_lastValue = value;
+            vendor_os_test_long_pendingValues.add(value);
+            if (vendor_os_test_long_dispatching) return;
+            vendor_os_test_long_dispatching = true;
+        }
+        boolean drained = false;
+        try {
+            for (;;) {
+                Optional<Long> value;
+                ArrayList<ChangeCallback<Optional<Long>>> callbacks;
+                synchronized (sChangeCallbackLock) {
+                    value = vendor_os_test_long_pendingValues.poll();
+                    if (value == null) {
+                        vendor_os_test_long_dispatching = false;
+                        drained = true;
+                        return;
+                    }
+                    callbacks = new ArrayList<>(vendor_os_test_long_changeCallbacks);
+                }
+                for (int i = 0; i < callbacks.size(); ++i) {
+                    callbacks.get(i).onChange(value);
+                }
+            }
+        } finally {
+            if (!drained) {
+                synchronized (sChangeCallbackLock) {
+                    vendor_os_test_long_pendingValues.clear();
+                    vendor_os_test_long_dispatching = false;
+                }
+            }
+        }
+    }
+
+    public static List<Integer> test_list_int() {
+        String value = SystemProperties.get("vendor.test_list_int");
+        return tryParseList(v -> tryParseInteger(v), value);
+    }
+
+    public static void test_list_int(List<Integer> value) {
+        SystemProperties.set("vendor.test_list_int", value == null ? "" : formatList(value));
+    }
+
+    private static final ArrayList<ChangeCallback<List<Integer>>> test_list_int_changeCallbacks = new ArrayList<>();
+    private static List<Integer> test_list_int_lastValue;
+    private static final ArrayDeque<List<Integer>> test_list_int_pendingValues = new ArrayDeque<>();
+    private static boolean test_list_int_dispatching;
+
+    public static void test_list_int_addChangeCallback(ChangeCallback<List<Integer>> callback) {
+        synchronized (sChangeCallbackLock) {
+            if (test_list_int_changeCallbacks.isEmpty()) test_list_int_lastValue = test_list_int();
+            test_list_int_changeCallbacks.add(callback);
+            registerChangeCallbackLocked();
+        }
+    }
+
+    public static void test_list_int_removeChangeCallback(ChangeCallback<List<Integer>> callback) {
+        synchronized (sChangeCallbackLock) {
+            test_list_int_changeCallbacks.remove(callback);
+        }
+    }
+
+    private static void test_list_int_dispatchChange() {
+        synchronized (sChangeCallbackLock) {
+            if (test_list_int_changeCallbacks.isEmpty()) return;
+            List<Integer> value = test_list_int();
+            if (value.equals(test_list_int_lastValue)) return;
+            test_list_int_lastValue = value;
+            test_list_int_pendingValues.add(value);
+            if (test_list_int_dispatching) return;
+            test_list_int_dispatching = true;
+        }
+        boolean drained = false;
+        try {
+            for (;;) {
+                List<Integer> value;
+                ArrayList<ChangeCallback<List<Integer>>> callbacks;
+                synchronized (sChangeCallbackLock) {
+                    value = test_list_int_pendingValues.poll();
+                    if (value == null) {
+                        test_list_int_dispatching = false;
+                        drained = true;
+                        return;
+                    }
+                    callbacks = new ArrayList<>(test_list_int_changeCallbacks);
+                }
+                for (int i = 0; i < callbacks.size(); ++i) {
+                    callbacks.get(i).onChange(value);
+                }
+            }
+        } finally {
+            if (!drained) {
+                synchronized (sChangeCallbackLock) {
+                    test_list_int_pendingValues.clear();
+                    test_list_int_dispatching = false;
+                }
+            }
+        }
+    }
+
+    @Deprecated
+    public static List<String> test_strlist() {
+        String value = SystemProperties.get("vendor.test_strlist");
+        return tryParseList(v -> tryParseString(v), value);
+    }
+
+    @Deprecated
+    public static void test_strlist(List<String> value) {
+        SystemProperties.set("vendor.test_strlist", value == null ? "" : formatList(value));
+    }
+
+    private static final ArrayList<ChangeCallback<List<String>>> test_strlist_changeCallbacks = new ArrayList<>();
+    private static List<String> test_strlist_lastValue;
+    private static final ArrayDeque<List<String>> test_strlist_pendingValues = new ArrayDeque<>();
+    private static boolean test_strlist_dispatching;
+
+    @Deprecated
+    public static void test_strlist_addChangeCallback(ChangeCallback<List<String>> callback) {
+        synchronized (sChangeCallbackLock) {
+            if (test_strlist_changeCallbacks.isEmpty()) test_strlist_lastValue = test_strlist();
+            test_strlist_changeCallbacks.add(callback);
+            registerChangeCallbackLocked();
+        }
+    }
+
+    @Deprecated
+    public static void test_strlist_removeChangeCallback(ChangeCallback<List<String>> callback) {
+        synchronized (sChangeCallbackLock) {
+            test_strlist_changeCallbacks.remove(callback);
+        }
+    }
+
+    private static void test_strlist_dispatchChange() {
+        synchronized (sChangeCallbackLock) {
+            if (test_strlist_changeCallbacks.isEmpty()) return;
+            List<String> value = test_strlist();
+            if (value.equals(test_strlist_lastValue)) return;
+            test_strlist_lastValue = value;
+            test_strlist_pendingValues.add(value);
+            if (test_strlist_dispatching) return;
+            test_strlist_dispatching = true;
+        }
+        boolean drained = false;
+        try {
+            for (;;) {
+                List<String> value;
+                ArrayList<ChangeCallback<List<String>>> callbacks;
+                synchronized (sChangeCallbackLock) {
+                    value = test_strlist_pendingValues.poll();
+                    if (value == null) {
+                        test_strlist_dispatching = false;
+                        drained = true;
+                        return;
+                    }
+                    callbacks = new ArrayList<>(test_strlist_changeCallbacks);
+                }
+                for (int i = 0; i < callbacks.size(); ++i) {
+                    callbacks.get(i).onChange(value);
+                }
+            }
+        } finally {
+            if (!drained) {
+                synchronized (sChangeCallbackLock) {
+                    test_strlist_pendingValues.clear();
+                    test_strlist_dispatching = false;
+                }
+            }
+        }
+    }
+
+    private static void onSystemPropertiesChanged() {
+        test_int_dispatchChange();
+        test_string_dispatchChange();
+        test_BOOLeaN_dispatchChange();
+        vendor_os_test_long_dispatchChange();
+        test_list_int_dispatchChange();
+        test_strlist_dispatchChange();
+    }
+}
+)s";
+
+constexpr const char* kExpectedSnapshotPublicOutput =
+    R"s(// Generated by the sysprop generator. DO NOT EDIT!
+
+package com.somecompany;
+
+import android.os.SystemProperties;
+
+import java.lang.StringBuilder;
+import java.util.ArrayList;
+import java.util.function.Function;
+import java.util.List;
+import java.util.Locale;
+import java.util.Optional;
+import java.util.StringJoiner;
+import java.util.stream.Collectors;
+
+public final class TestProperties {
+    private TestProperties () {}
+
+    private static Boolean tryParseBoolean(String str) {
+        switch (str.toLowerCase(Locale.US)) {
+            case "1":
+            case "true":
+                return Boolean.TRUE;
+            case "0":
+            case "false":
+                return Boolean.FALSE;
+            default:
+                return null;
+        }
+    }
+
+    private static Integer tryParseInteger(String str) {
+        try {
+            return Integer.valueOf(str);
+        } catch (NumberFormatException e) {
+            return null;
+        }
+    }
+
+    private static Long tryParseLong(String str) {
+        try {
+            return Long.valueOf(str);
+        } catch (NumberFormatException e) {
+            return null;
+        }
+    }
+
+    private static Double tryParseDouble(String str) {
+        try {
+            return Double.valueOf(str);
+        } catch (NumberFormatException e) {
+            return null;
+        }
+    }
+
+    private static String tryParseString(String str) {
+        return "".equals(str) ? null : str;
+    }
+
+    private static <T extends Enum<T>> T tryParseEnum(Class<T> enumType, String str) {
+        try {
+            return Enum.valueOf(enumType, str.toUpperCase(Locale.US));
+        } catch (IllegalArgumentException e) {
+            return null;
+        }
+    }
+
+    private static <T> List<T> tryParseList(Function<String, T> elementParser, String str) {
+        if ("".equals(str)) return new ArrayList<>();
+
+        List<T> ret = new ArrayList<>();
+
+        int p = 0;
+        for (;;) {
+            StringBuilder sb = new StringBuilder();
+            while (p < str.length() && str.charAt(p) != ',') {
+                if (str.charAt(p) == '\\') ++p;
+                if (p == str.length()) break;
+                sb.append(str.charAt(p++));
+            }
+            ret.add(elementParser.apply(sb.toString()));
+            if (p == str.length()) break;
+            ++p;
+        }
+
+        return ret;
+    }
+
+    private static <T extends Enum<T>> List<T> tryParseEnumList(Class<T> enumType, String str) {
+        if ("".equals(str)) return new ArrayList<>();
+
+        List<T> ret = new ArrayList<>();
+
+        for (String element : str.split(",")) {
+            ret.add(tryParseEnum(enumType, element));
+        }
+
+        return ret;
+    }
+
+    private static String escape(String str) {
+        return str.replaceAll("([\\\\,])", "\\\\$1");
+    }
+
+    private static <T> String formatList(List<T> list) {
+        StringJoiner joiner = new StringJoiner(",");
+
+        for (T element : list) {
+            joiner.add(element == null ? "" : escape(element.toString()));
+        }
+
+        return joiner.toString();
+    }
+
+    private static <T extends Enum<T>> String formatEnumList(List<T> list, Function<T, String> elementFormatter) {
+        StringJoiner joiner = new StringJoiner(",");
+
+        for (T element : list) {
+            joiner.add(element == null ? "" : elementFormatter.apply(element));
+        }
+
+        return joiner.toString();
+    }
+
+    private static final Object sChangeCallbackLock = new Object();
+    private static boolean sChangeCallbackRegistered = false;
+
+    private static void registerChangeCallbackLocked() {
+        if (sChangeCallbackRegistered) return;
+        sChangeCallbackRegistered = true;
+        SystemProperties.addChangeCallback(new Runnable() {
+            @Override
+            public void run() {
+                onSystemPropertiesChanged();
+            }
+        });
+    }
+
+    private static final int SNAPSHOT_MAX_ATTEMPTS = 3;
+    private static volatile int sChangeCount = 0;
+
+    public static Optional<Integer> test_int() {
+        String value = SystemProperties.get("vendor.test_int");
+        return Optional.ofNullable(tryParseInteger(value));
+    }
+
+    public static void test_int(Integer value) {
+        SystemProperties.set("vendor.test_int", value == null ? "" : value.toString());
+    }
+
+    public static Optional<String> test_string() {
+        String value = SystemProperties.get("vendor.test.string");
+        return Optional.ofNullable(tryParseString(value));
+    }
+
+    public static void test_string(String value) {
+        SystemProperties.set("vendor.test.string", value == null ? "" : value.toString());
+    }
+
+    public static Optional<Boolean> test_BOOLeaN() {
+        String value = SystemProperties.get("ro.vendor.test.b");
+        return Optional.ofNullable(tryParseBoolean(value));
+    }
+
+    public static void test_BOOLeaN(Boolean value) {
+        SystemProperties.set("ro.vendor.test.b", value == null ? "" : value.toString());
+    }
+
+    public static Optional<Long> vendor_os_test_long() {
+        String value = SystemProperties.get("vendor.vendor_os_test-long");
+        return Optional.ofNullable(tryParseLong(value));
+    }
+
+    public static void vendor_os_test_long(Long value) {
+        SystemProperties.set("vendor.vendor_os_test-long", value == null ? "" : value.toString());
+    }
+
+    public static List<Integer> test_list_int() {
+        String value = SystemProperties.get("vendor.test_list_int");
+        return tryParseList(v -> tryParseInteger(v), value);
+    }
+
+    public static void test_list_int(List<Integer> value) {
+        SystemProperties.set("vendor.test_list_int", value == null ? "" : formatList(value));
+    }
+
+    @Deprecated
+    public static List<String> test_strlist() {
+        String value = SystemProperties.get("vendor.test_strlist");
+        return tryParseList(v -> tryParseString(v), value);
+    }
+
+    @Deprecated
+    public static void test_strlist(List<String> value) {
+        SystemProperties.set("vendor.test_strlist", value == null ? "" : formatList(value));
+    }
+
+    public static final class Snapshot {
+        public final Optional<Integer> test_int;
+        public final Optional<String> test_string;
+        public final Optional<Boolean> test_BOOLeaN;
+        public final Optional<Long> vendor_os_test_long;
+        public final List<Integer> test_list_int;
+        @Deprecated
+        public final List<String> test_strlist;
+
+        private Snapshot() {
+            this.test_int = test_int();
+            this.test_string = test_string();
+            this.test_BOOLeaN = test_BOOLeaN();
+            this.vendor_os_test_long = vendor_os_test_long();
+            this.test_list_int = test_list_int();
+            this.test_strlist = test_strlist();
+        }
+    }
+
+    // Best effort: the props are re-read if a change was reported meanwhile,
+    // up to SNAPSHOT_MAX_ATTEMPTS times, and the last read is returned either
+    // way. Changes are reported asynchronously, so one made while reading may
+    // go unnoticed and the Snapshot may mix old and new values.
+    public static Snapshot snapshot() {
+        synchronized (sChangeCallbackLock) {
+            registerChangeCallbackLocked();
+        }
+        Snapshot snapshot = null;
+        for (int attempt = 0; attempt < SNAPSHOT_MAX_ATTEMPTS; ++attempt) {
+            int changeCount = sChangeCount;
+            snapshot = new Snapshot();
+            if (changeCount == sChangeCount) break;
+        }
+        return snapshot;
+    }
+
+    private static void onSystemPropertiesChanged() {
+        synchronized (sChangeCallbackLock) {
+            ++sChangeCount;
+        }
+    }
+}
+)s";
 
 using namespace std::string_literals;
 
+// Generates the class for kTestSyspropFile through GenerateJavaLibrary(), from
+// a sysprop file on disk, and returns its content.
+android::base::Result<std::string> GenerateTestJavaClass(
+    sysprop::Scope scope, const JavaGenOptions& options = {}) {
+  TemporaryFile temp_file;
+  if (!android::base::WriteStringToFd(kTestSyspropFile, temp_file.fd)) {
+    return android::base::ErrnoErrorf("Writing {} failed", temp_file.path);
+  }
+
+  TemporaryDir temp_dir;
+  if (auto res = GenerateJavaLibrary(temp_file.path, scope, temp_dir.path,
+                                     options);
+      !res.ok()) {
+    return res.error();
+  }
+
+  std::string java_output_path =
+      temp_dir.path + "/com/somecompany/TestProperties.java"s;
+  std::string java_output;
+  bool read = android::base::ReadFileToString(java_output_path, &java_output,
+                                              true);
+
+  unlink(java_output_path.c_str());
+  rmdir((temp_dir.path + "/com/somecompany"s).c_str());
+  rmdir((temp_dir.path + "/com"s).c_str());
+
+  if (!read) {
+    return android::base::ErrnoErrorf("Reading {} failed", java_output_path);
+  }
+  return java_output;
+}
+
+}  // namespace
+
+const char* const kJavaGenTestSyspropFile = kTestSyspropFile;
+
 TEST(SyspropTest, JavaGenTest) {
   TemporaryFile temp_file;
 
@@ -570,3 +2179,138 @@ TEST(SyspropTest, JavaGenTest) {
     rmdir((temp_dir.path + "/com"s).c_str());
   }
 }
+
+TEST(SyspropTest, JavaGenInMemoryTest) {
+  auto props = ParsePropsFromString(kTestSyspropFile);
+  ASSERT_RESULT_OK(props);
+
+  EXPECT_EQ(GetJavaClassPath(*props), "com/somecompany/TestProperties.java");
+  auto internal_output = GenerateJavaClass(*props, sysprop::Scope::Internal);
+  ASSERT_RESULT_OK(internal_output);
+  EXPECT_EQ(*internal_output, kExpectedInternalOutput);
+  auto public_output = GenerateJavaClass(*props, sysprop::Scope::Public);
+  ASSERT_RESULT_OK(public_output);
+  EXPECT_EQ(*public_output, kExpectedPublicOutput);
+
+  EXPECT_FALSE(ParsePropsFromString("owner: Invalid").ok());
+}
+
+TEST(SyspropTest, JavaOutputPathCollisionTest) {
+  auto props = ParsePropsFromString(kTestSyspropFile);
+  ASSERT_RESULT_OK(props);
+
+  // Another sysprop file with the same module generates the same class.
+  sysprop::Properties other = *props;
+  other.mutable_prop()->DeleteSubrange(1, other.prop_size() - 1);
+  std::string path = GetJavaOutputPath(*props, "out");
+  EXPECT_EQ(path, "out/com/somecompany/TestProperties.java");
+  EXPECT_EQ(GetJavaOutputPath(other, "out"), path);
+
+  auto res = CheckDistinctOutputPaths({path, GetJavaOutputPath(other, "out2"),
+                                       GetJavaOutputPath(other, "out")});
+  ASSERT_FALSE(res.ok());
+  EXPECT_EQ(res.error().message(), path + " would be generated more than once");
+
+  other.set_module("com.somecompany.OtherProperties");
+  EXPECT_RESULT_OK(
+      CheckDistinctOutputPaths({path, GetJavaOutputPath(other, "out")}));
+}
+
+TEST(SyspropTest, JavaGenLambdaFreeTest) {
+  JavaGenOptions options;
+  options.lambda_free = true;
+  auto java_output = GenerateTestJavaClass(sysprop::Internal, options);
+  ASSERT_RESULT_OK(java_output);
+  EXPECT_EQ(*java_output, kExpectedLambdaFreeInternalOutput);
+}
+
+TEST(SyspropTest, JavaGenPrimitiveArraysTest) {
+  JavaGenOptions options;
+  options.primitive_arrays = true;
+  auto java_output = GenerateTestJavaClass(sysprop::Internal, options);
+  ASSERT_RESULT_OK(java_output);
+  EXPECT_EQ(*java_output, kExpectedPrimitiveArraysInternalOutput);
+
+  // A prop named after the array accessors of a list prop can't coexist with
+  // them.
+  auto props = ParsePropsFromString(kTestSyspropFile);
+  ASSERT_RESULT_OK(props);
+  sysprop::Property* clash = props->add_prop();
+  clash->set_api_name("test_list_int_array");
+  clash->set_type(sysprop::Integer);
+  clash->set_scope(sysprop::Internal);
+  clash->set_access(sysprop::Readonly);
+  clash->set_prop_name("vendor.test_list_int_array");
+
+  auto res = GenerateJavaClass(*props, sysprop::Internal, options);
+  ASSERT_FALSE(res.ok());
+  EXPECT_EQ(res.error().message(),
+            "test_list_int_array generated for prop test_list_int_array "
+            "clashes with the one generated for prop test_list_int");
+
+  options.primitive_arrays = false;
+  EXPECT_RESULT_OK(GenerateJavaClass(*props, sysprop::Internal, options));
+}
+
+TEST(SyspropTest, JavaGenChangeCallbacksTest) {
+  JavaGenOptions options;
+  options.change_callbacks = true;
+  auto java_output = GenerateTestJavaClass(sysprop::Public, options);
+  ASSERT_RESULT_OK(java_output);
+  EXPECT_EQ(*java_output, kExpectedChangeCallbacksPublicOutput);
+
+  // A prop named after the callback members of another prop can't coexist
+  // with them.
+  auto props = ParsePropsFromString(kTestSyspropFile);
+  ASSERT_RESULT_OK(props);
+  sysprop::Property* clash = props->add_prop();
+  clash->set_api_name("test_int_lastValue");
+  clash->set_type(sysprop::Integer);
+  clash->set_scope(sysprop::Public);
+  clash->set_access(sysprop::Readonly);
+  clash->set_prop_name("vendor.test_int_last_value");
+
+  auto res = GenerateJavaClass(*props, sysprop::Public, options);
+  ASSERT_FALSE(res.ok());
+  EXPECT_EQ(res.error().message(),
+            "test_int_lastValue generated for prop test_int_lastValue "
+            "clashes with the one generated for prop test_int");
+
+  options.change_callbacks = false;
+  EXPECT_RESULT_OK(GenerateJavaClass(*props, sysprop::Public, options));
+}
+
+TEST(SyspropTest, JavaGenSnapshotTest) {
+  JavaGenOptions options;
+  options.snapshot = true;
+  auto java_output = GenerateTestJavaClass(sysprop::Public, options);
+  ASSERT_RESULT_OK(java_output);
+  EXPECT_EQ(*java_output, kExpectedSnapshotPublicOutput);
+
+  // More props than a Java method may take parameters.
+  sysprop::Properties big;
+  big.set_owner(sysprop::Platform);
+  big.set_module("android.sysprop.Big");
+  for (int i = 0; i < 300; ++i) {
+    sysprop::Property* prop = big.add_prop();
+    prop->set_api_name("p" + std::to_string(i));
+    prop->set_type(sysprop::Integer);
+    prop->set_access(sysprop::Readonly);
+    prop->set_prop_name("ro.big.p" + std::to_string(i));
+  }
+  auto big_output = GenerateJavaClass(big, sysprop::Public, options);
+  ASSERT_RESULT_OK(big_output);
+  EXPECT_NE(big_output->find("private Snapshot() {"), std::string::npos);
+  EXPECT_NE(big_output->find("this.p299 = p299();"), std::string::npos);
+
+  // A prop accessor named snapshot() would clash with the factory.
+  big.mutable_prop(0)->set_api_name("snapshot");
+  auto res = GenerateJavaClass(big, sysprop::Public, options);
+  ASSERT_FALSE(res.ok());
+  EXPECT_EQ(res.error().message(),
+            "snapshot generated for prop snapshot clashes with the one "
+            "generated for the snapshot() factory");
+
+  options.snapshot = false;
+  EXPECT_RESULT_OK(GenerateJavaClass(big, sysprop::Public, options));
+}
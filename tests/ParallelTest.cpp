@@ -1,5 +1,5 @@
 /*
- * Copyright (C) 2018 The Android Open Source Project
+ * Copyright (C) 2019 The Android Open Source Project
  *
  * Licensed under the Apache License, Version 2.0 (the "License");
  * you may not use this file except in compliance with the License.
@@ -14,12 +14,18 @@
  * limitations under the License.
  */
 
-#pragma once
+#include <vector>
 
-#include <android-base/result.h>
-#include <string>
+#include <gtest/gtest.h>
 
-android::base::Result<void> GenerateCppFiles(
-    const std::string& input_file_path, const std::string& header_dir,
-    const std::string& public_header_dir, const std::string& source_output_dir,
-    const std::string& include_name);
\ No newline at end of file
+#include "Parallel.h"
+
+TEST(SyspropTest, ParallelForTest) {
+  for (unsigned num_threads : {0u, 1u, 4u, 64u}) {
+    std::vector<int> calls(1000);
+    ParallelFor(calls.size(), num_threads, [&](size_t i) { ++calls[i]; });
+    EXPECT_EQ(calls, std::vector<int>(calls.size(), 1)) << num_threads;
+  }
+
+  ParallelFor(0, 4, [](size_t) { FAIL() << "called for empty range"; });
+}
@@ -0,0 +1,326 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <memory>
+#include <regex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <android-base/file.h>
+#include <android-base/scopeguard.h>
+#include <android-base/test_utils.h>
+#include <gtest/gtest.h>
+
+#include "Common.h"
+
+namespace {
+
+constexpr const char* kTestSyspropFile =
+    R"(
+owner: Platform
+module: "android.cache"
+prop {
+    api_name: "prop"
+    type: Integer
+    scope: Public
+    access: ReadWrite
+}
+)";
+
+std::vector<std::string> ListDir(const std::string& path) {
+  std::vector<std::string> ret;
+  std::unique_ptr<DIR, int (*)(DIR*)> dir(opendir(path.c_str()), closedir);
+  if (!dir) return ret;
+  while (dirent* entry = readdir(dir.get())) {
+    std::string name = entry->d_name;
+    if (name != "." && name != "..") ret.push_back(path + "/" + name);
+  }
+  return ret;
+}
+
+}  // namespace
+
+using namespace std::string_literals;
+
+TEST(SyspropTest, ParseCacheTest) {
+  TemporaryDir temp_dir;
+  std::string cache_dir = temp_dir.path + "/cache"s;
+  std::string sysprop_path = temp_dir.path + "/Cache.sysprop"s;
+  ASSERT_TRUE(android::base::WriteStringToFile(kTestSyspropFile, sysprop_path));
+
+  ASSERT_EQ(setenv("SYSPROP_CACHE_DIR", cache_dir.c_str(), 1), 0);
+  auto unset = android::base::make_scope_guard(
+      [] { unsetenv("SYSPROP_CACHE_DIR"); });
+
+  auto first = ParseProps(sysprop_path);
+  ASSERT_RESULT_OK(first);
+  EXPECT_EQ(first->prop(0).prop_name(), "prop");
+
+  std::vector<std::string> entries = ListDir(cache_dir);
+  ASSERT_EQ(entries.size(), 1u);
+
+  // Entries hold the 32-byte digest they are named after, the size of the
+  // message and the message.
+  std::string entry;
+  ASSERT_TRUE(android::base::ReadFileToString(entries[0], &entry));
+  std::string serialized = first->SerializeAsString();
+  ASSERT_EQ(entry.size(), 40 + serialized.size());
+  EXPECT_EQ(entry.substr(40), serialized);
+
+  // A cache hit returns what was stored instead of parsing the file again.
+  sysprop::Properties cached = *first;
+  cached.mutable_prop(0)->set_prop_name("from.cache");
+  serialized = cached.SerializeAsString();
+  uint64_t size = serialized.size();
+  std::string cached_entry = entry.substr(0, 32);
+  cached_entry.append(reinterpret_cast<const char*>(&size), sizeof(size));
+  cached_entry += serialized;
+  ASSERT_TRUE(android::base::WriteStringToFile(cached_entry, entries[0]));
+
+  auto second = ParseProps(sysprop_path);
+  ASSERT_RESULT_OK(second);
+  EXPECT_EQ(second->prop(0).prop_name(), "from.cache");
+
+  // Truncated entries and entries stored for other contents are ignored.
+  ASSERT_TRUE(android::base::WriteStringToFile(
+      cached_entry.substr(0, cached_entry.size() - 1), entries[0]));
+  auto truncated = ParseProps(sysprop_path);
+  ASSERT_RESULT_OK(truncated);
+  EXPECT_EQ(truncated->prop(0).prop_name(), "prop");
+
+  cached_entry[0] ^= 1;
+  ASSERT_TRUE(android::base::WriteStringToFile(cached_entry, entries[0]));
+  auto other_digest = ParseProps(sysprop_path);
+  ASSERT_RESULT_OK(other_digest);
+  EXPECT_EQ(other_digest->prop(0).prop_name(), "prop");
+
+  // Other contents get their own entry, and invalid files aren't cached.
+  ASSERT_TRUE(android::base::WriteStringToFile(
+      kTestSyspropFile + "# comment\n"s, sysprop_path));
+  ASSERT_RESULT_OK(ParseProps(sysprop_path));
+  EXPECT_EQ(ListDir(cache_dir).size(), 2u);
+
+  ASSERT_TRUE(
+      android::base::WriteStringToFile("module: \"invalid\"", sysprop_path));
+  EXPECT_FALSE(ParseProps(sysprop_path).ok());
+  EXPECT_FALSE(ParseProps(sysprop_path).ok());
+  EXPECT_EQ(ListDir(cache_dir).size(), 2u);
+
+  // A corrupted entry is ignored and rewritten.
+  ASSERT_TRUE(android::base::WriteStringToFile("\xff\xff\xff", entries[0]));
+  ASSERT_TRUE(android::base::WriteStringToFile(kTestSyspropFile, sysprop_path));
+  auto third = ParseProps(sysprop_path);
+  ASSERT_RESULT_OK(third);
+  EXPECT_EQ(third->prop(0).prop_name(), "prop");
+}
+
+TEST(SyspropTest, ParseStdinTest) {
+  int pipe_fds[2];
+  ASSERT_EQ(pipe(pipe_fds), 0);
+  ASSERT_TRUE(android::base::WriteStringToFd(kTestSyspropFile, pipe_fds[1]));
+  close(pipe_fds[1]);
+
+  int saved_stdin = dup(STDIN_FILENO);
+  ASSERT_NE(saved_stdin, -1);
+  ASSERT_NE(dup2(pipe_fds[0], STDIN_FILENO), -1);
+  close(pipe_fds[0]);
+  auto restore = android::base::make_scope_guard([&] {
+    dup2(saved_stdin, STDIN_FILENO);
+    close(saved_stdin);
+  });
+
+  auto props = ParseProps(kStdioFilePath);
+  ASSERT_RESULT_OK(props);
+  EXPECT_EQ(props->module(), "android.cache");
+  EXPECT_EQ(props->prop(0).prop_name(), "prop");
+}
+
+TEST(SyspropTest, ParseFromStringTest) {
+  auto props = ParsePropsFromString(kTestSyspropFile);
+  ASSERT_RESULT_OK(props);
+
+  sysprop::SyspropLibraryApis api;
+  *api.add_props() = *props;
+  *api.add_props() = *props;
+  EXPECT_FALSE(ParseApiFileFromString(api.DebugString()).ok());
+
+  api.mutable_props(1)->set_module("android.cache2");
+  auto res = ParseApiFileFromString(api.DebugString());
+  ASSERT_RESULT_OK(res);
+  ASSERT_EQ(res->props_size(), 2);
+  EXPECT_EQ(res->props(1).module(), "android.cache2");
+}
+
+TEST(SyspropTest, ParseArenaTest) {
+  TemporaryFile props_file;
+  ASSERT_TRUE(android::base::WriteStringToFile(kTestSyspropFile,
+                                               props_file.path));
+
+  auto heap_props = ParseProps(props_file.path);
+  ASSERT_RESULT_OK(heap_props);
+
+  google::protobuf::Arena arena(GetParseArenaOptions());
+  auto props = ParseProps(props_file.path, &arena);
+  ASSERT_RESULT_OK(props);
+  EXPECT_EQ((*props)->GetArena(), &arena);
+  EXPECT_EQ((*props)->SerializeAsString(), heap_props->SerializeAsString());
+
+  sysprop::SyspropLibraryApis api;
+  *api.add_props() = **props;
+  TemporaryFile api_file;
+  ASSERT_TRUE(android::base::WriteStringToFile(api.DebugString(),
+                                               api_file.path));
+
+  auto apis = ParseApiFile(api_file.path, &arena);
+  ASSERT_RESULT_OK(apis);
+  EXPECT_EQ((*apis)->GetArena(), &arena);
+  ASSERT_EQ((*apis)->props_size(), 1);
+  EXPECT_EQ((*apis)->props(0).GetArena(), &arena);
+  EXPECT_EQ((*apis)->props(0).SerializeAsString(),
+            heap_props->SerializeAsString());
+
+  EXPECT_FALSE(ParseProps(api_file.path + "-missing"s, &arena).ok());
+}
+
+TEST(SyspropTest, ApiFileReaderTest) {
+  TemporaryFile api_file;
+  ASSERT_TRUE(android::base::WriteStringToFile(
+      R"(# comment with "props {"
+props {
+  owner: Platform
+  module: "android.a"
+  prop { api_name: "a" type: String access: Readonly prop_name: "ro.a" } # }
+}
+props: < owner: Vendor module: "vendor.b" # comment with }
+  prop < api_name: "b" access: ReadWrite prop_name: "vendor.b" > >
+)",
+      api_file.path));
+
+  ApiFileReader reader;
+  ASSERT_RESULT_OK(reader.Open(api_file.path));
+  sysprop::Properties props;
+
+  auto res = reader.Next(&props);
+  ASSERT_RESULT_OK(res);
+  ASSERT_TRUE(*res);
+  EXPECT_EQ(props.module(), "android.a");
+  ASSERT_EQ(props.prop_size(), 1);
+  EXPECT_EQ(props.prop(0).prop_name(), "ro.a");
+
+  res = reader.Next(&props);
+  ASSERT_RESULT_OK(res);
+  ASSERT_TRUE(*res);
+  EXPECT_EQ(props.module(), "vendor.b");
+  ASSERT_EQ(props.prop_size(), 1);
+  EXPECT_EQ(props.prop(0).api_name(), "b");
+
+  res = reader.Next(&props);
+  ASSERT_RESULT_OK(res);
+  EXPECT_FALSE(*res);
+
+  // Enough modules to take several reads.
+  sysprop::SyspropLibraryApis api;
+  for (int i = 0; i < 1000; ++i) {
+    sysprop::Properties* module = api.add_props();
+    module->set_owner(sysprop::Platform);
+    module->set_module("android.m" + std::to_string(i));
+    sysprop::Property* prop = module->add_prop();
+    prop->set_api_name("prop");
+    prop->set_access(sysprop::Readonly);
+    prop->set_prop_name("ro.m" + std::to_string(i) + std::string(100, 'x'));
+  }
+  ASSERT_TRUE(android::base::WriteStringToFile(api.DebugString(),
+                                               api_file.path));
+  auto whole_api = ParseApiFile(api_file.path);
+  ASSERT_RESULT_OK(whole_api);
+
+  ApiFileReader big_reader;
+  ASSERT_RESULT_OK(big_reader.Open(api_file.path));
+  for (const sysprop::Properties& expected : whole_api->props()) {
+    res = big_reader.Next(&props);
+    ASSERT_RESULT_OK(res);
+    ASSERT_TRUE(*res);
+    EXPECT_EQ(props.SerializeAsString(), expected.SerializeAsString());
+  }
+  res = big_reader.Next(&props);
+  ASSERT_RESULT_OK(res);
+  EXPECT_FALSE(*res);
+
+  for (const char* contents :
+       {"props { owner: Platform module: \"android.a\" ",
+        "\n\nunknown { }", "props { module: \"android.a\" }"}) {
+    ASSERT_TRUE(android::base::WriteStringToFile(contents, api_file.path));
+    ApiFileReader invalid_reader;
+    ASSERT_RESULT_OK(invalid_reader.Open(api_file.path));
+    EXPECT_FALSE(invalid_reader.Next(&props).ok()) << contents;
+  }
+
+  EXPECT_FALSE(reader.Open(api_file.path + "-missing"s).ok());
+}
+
+TEST(SyspropTest, OwnerNamespaceTest) {
+  // The regexes the namespace checks used to be implemented with.
+  const std::regex vendor_regex(
+      "(init\\.svc\\.|ro\\.|persist\\.)?vendor\\..+|ro\\.hardware\\..+");
+  const std::regex odm_regex(
+      "(init\\.svc\\.|ro\\.|persist\\.)?odm\\..+|ro\\.hardware\\..+");
+
+  const char* prop_names[] = {
+      "vendor.a",          "vendor.",          "vendorx.a",
+      "ro.vendor.a",       "ro.vendor.",       "persist.vendor.a",
+      "init.svc.vendor.a", "init.svc.odm.a",   "init.vendor.a",
+      "odm.a",             "ro.odm.a",         "persist.odm.",
+      "ro.hardware.a",     "ro.hardware.",     "hardware.a",
+      "ro.ro.vendor.a",    "ro.persist.odm.a", "a.vendor.b",
+      "vendor.odm.a",      "ro.a",             "ctl.vendor.a",
+  };
+
+  for (const char* prop_name : prop_names) {
+    for (auto [owner, owner_name] : {std::pair(sysprop::Platform, "Platform"),
+                                     std::pair(sysprop::Vendor, "Vendor"),
+                                     std::pair(sysprop::Odm, "Odm")}) {
+      bool expected;
+      switch (owner) {
+        case sysprop::Vendor:
+          expected = std::regex_match(prop_name, vendor_regex);
+          break;
+        case sysprop::Odm:
+          expected = std::regex_match(prop_name, odm_regex);
+          break;
+        default:
+          expected = !std::regex_match(prop_name, vendor_regex) &&
+                     !std::regex_match(prop_name, odm_regex);
+          break;
+      }
+
+      std::string contents = "owner: "s + owner_name +
+                             " module: \"android.ns\" prop { api_name: \"a\" "
+                             "access: Readonly prop_name: \"" +
+                             prop_name + "\" }";
+      EXPECT_EQ(ParsePropsFromString(contents).ok(), expected)
+          << prop_name << " owned by " << owner_name;
+    }
+  }
+
+  EXPECT_EQ(ApiNameToIdentifier("a-b.c_d"), "a_b_c_d");
+  EXPECT_EQ(ApiNameToIdentifier("1-a"), "_1_a");
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <random>
+#include <string>
+
+#include <google/protobuf/io/tokenizer.h>
+#include <google/protobuf/text_format.h>
+#include <gtest/gtest.h>
+
+#include "TestInputs.h"
+#include "TextParser.h"
+
+namespace {
+
+constexpr const char* kPropertiesCorpus[] = {
+    R"(owner: Platform
+module: "android.sysprop.PlatformProperties"
+prop {
+    api_name: "test_double"
+    type: Double
+    prop_name: "android.test_double"
+    scope: Internal
+    access: ReadWrite
+}
+prop {
+    api_name: "test_enum"
+    type: EnumList
+    scope: Public
+    access: Writeonce
+    enum_values: "a|b|c|D|e|f|G"
+    deprecated: true
+}
+prop {
+    api_name: "test_BOOLeaN"
+    type: Boolean
+    prop_name: "ro.compat.test.b"
+    scope: System
+    access: Readonly
+    integer_as_bool: true
+}
+)",
+    // Comments, separators, optional colons and alternative literals.
+    "# comment\nowner:Vendor;module:'com.a.B'# trailing\n"
+    "prop: {api_name:\"x\",type:Integer;integer_as_bool:t deprecated:0},"
+    "prop{}",
+    // Escapes and concatenated strings.
+    R"(module: "a\n\t\\\"\'\x41\101\?" 'b' "c" prop { api_name: "\x4" })",
+    "",
+    "  # only a comment",
+    // Inputs TextFormat accepts but the fast parser leaves to it.
+    "owner: 1 module: \"a.b\"",
+    "prop < api_name: \"a\" >",
+    "prop { api_name: \"a\" type: 4 }",
+    "prop: [{ api_name: \"a\" }, { api_name: \"b\" }]",
+    "prop { deprecated: True integer_as_bool: False }",
+    // Inputs TextFormat rejects.
+    "module: \"a\" module: \"b\"",
+    "owner: Nobody",
+    "unknown: 1",
+    "prop { api_name: \"a\"",
+    "prop { api_name: \"a }",
+    "prop { api_name: \"a\" } }",
+    "module \"a\"",
+    "prop { deprecated: 2 }",
+    "prop { deprecated: truely }",
+    "module: \"\\z\"",
+    "module: \"a\nb\"",
+};
+
+template <typename Message>
+std::string ParseWithTextFormat(const std::string& text, bool* ok) {
+  Message message;
+  google::protobuf::TextFormat::Parser parser;
+  // Keep expected failures out of the test log.
+  struct : google::protobuf::io::ErrorCollector {
+    void AddError(int, google::protobuf::io::ColumnNumber,
+                  const std::string&) override {}
+  } errors;
+  parser.RecordErrorsTo(&errors);
+  *ok = parser.ParseFromString(text, &message);
+  return message.SerializeAsString();
+}
+
+// Whenever the fast parser accepts |text|, TextFormat must accept it too and
+// produce the same message. Returns whether the fast parser accepted it.
+template <typename Message = sysprop::Properties>
+bool ExpectSameAsTextFormat(const std::string& text) {
+  Message message;
+  if (!FastParseTextFormat(text, &message).ok()) return false;
+
+  bool ok;
+  std::string expected = ParseWithTextFormat<Message>(text, &ok);
+  EXPECT_TRUE(ok) << text;
+  EXPECT_EQ(message.SerializeAsString(), expected) << text;
+  return true;
+}
+
+}  // namespace
+
+TEST(SyspropTest, TextParserDifferentialTest) {
+  for (const char* text : kPropertiesCorpus) {
+    ExpectSameAsTextFormat(text);
+  }
+
+  // The inputs of the other tests are real sysprop and API files, which must
+  // all take the fast path.
+  EXPECT_TRUE(ExpectSameAsTextFormat(kCppGenTestSyspropFile));
+  EXPECT_TRUE(ExpectSameAsTextFormat(kJavaGenTestSyspropFile));
+  EXPECT_TRUE(ExpectSameAsTextFormat<sysprop::SyspropLibraryApis>(
+      kApiCheckerTestLatestApi));
+  EXPECT_TRUE(ExpectSameAsTextFormat<sysprop::SyspropLibraryApis>(
+      kApiCheckerTestCurrentApi));
+  EXPECT_TRUE(ExpectSameAsTextFormat<sysprop::SyspropLibraryApis>(
+      kApiCheckerTestInvalidCurrentApi));
+  for (const char* text : GetInvalidSyspropTestInputs()) {
+    EXPECT_TRUE(ExpectSameAsTextFormat(text)) << text;
+  }
+
+  // The first entry and the typical syntax must take the fast path.
+  sysprop::Properties props;
+  ASSERT_RESULT_OK(FastParseTextFormat(kPropertiesCorpus[0], &props));
+  EXPECT_EQ(props.prop_size(), 3);
+  ASSERT_RESULT_OK(FastParseTextFormat(kPropertiesCorpus[1], &props));
+  ASSERT_RESULT_OK(FastParseTextFormat(kPropertiesCorpus[2], &props));
+  EXPECT_EQ(props.module(), "a\n\t\\\"'AA?bc");
+  EXPECT_EQ(props.prop(0).api_name(), "\x4");
+
+  // Randomly mutated inputs exercise the error paths.
+  std::mt19937 rng(20190101);
+  const std::string base = kPropertiesCorpus[0];
+  const std::string alphabet = " \n{}:;,#\"'\\xtf01aT_";
+  for (int i = 0; i < 2000; ++i) {
+    std::string text = base;
+    int mutations = 1 + rng() % 3;
+    for (int j = 0; j < mutations; ++j) {
+      size_t pos = rng() % text.size();
+      switch (rng() % 3) {
+        case 0:
+          text.erase(pos, 1);
+          break;
+        case 1:
+          text.insert(pos, 1, alphabet[rng() % alphabet.size()]);
+          break;
+        default:
+          text[pos] = alphabet[rng() % alphabet.size()];
+          break;
+      }
+    }
+    ExpectSameAsTextFormat(text);
+  }
+}
+
+TEST(SyspropTest, TextParserApiFileTest) {
+  constexpr const char* kApiFile = R"(
+props {
+  owner: Vendor
+  module: "android.a"
+  prop { api_name: "a" type: String scope: Public access: Readonly }
+}
+props {
+  module: "android.b"
+}
+)";
+
+  sysprop::SyspropLibraryApis api;
+  ASSERT_RESULT_OK(FastParseTextFormat(kApiFile, &api));
+
+  sysprop::SyspropLibraryApis expected;
+  ASSERT_TRUE(
+      google::protobuf::TextFormat::ParseFromString(kApiFile, &expected));
+  EXPECT_EQ(api.SerializeAsString(), expected.SerializeAsString());
+}
+
+TEST(SyspropTest, TextParserErrorTest) {
+  sysprop::Properties props;
+  auto res = FastParseTextFormat("module: \"a\"\nprop {\n  type: Strin }", &props);
+  ASSERT_FALSE(res.ok());
+  EXPECT_EQ(res.error().message(), "3:9: unknown enum value");
+}
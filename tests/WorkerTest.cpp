@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <getopt.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <android-base/logging.h>
+#include <android-base/test_utils.h>
+#include <google/protobuf/io/zero_copy_stream_impl.h>
+#include <google/protobuf/util/delimited_message_util.h>
+#include <gtest/gtest.h>
+
+#include "Worker.h"
+#include "worker_protocol.pb.h"
+
+TEST(SyspropTest, WorkerTest) {
+  TemporaryFile requests;
+  TemporaryFile responses;
+
+  {
+    google::protobuf::io::FileOutputStream output(requests.fd);
+    sysprop::worker::WorkRequest request;
+    request.add_arguments("--flag");
+    request.add_arguments("first");
+    request.set_request_id(1);
+    ASSERT_TRUE(google::protobuf::util::SerializeDelimitedToZeroCopyStream(
+        request, &output));
+
+    request.Clear();
+    request.add_arguments("second");
+    request.set_request_id(2);
+    ASSERT_TRUE(google::protobuf::util::SerializeDelimitedToZeroCopyStream(
+        request, &output));
+    ASSERT_TRUE(output.Flush());
+  }
+  ASSERT_EQ(lseek(requests.fd, 0, SEEK_SET), 0);
+
+  std::vector<std::vector<std::string>> calls;
+  int ret = ServeWorkRequests(
+      requests.fd, responses.fd, {"tool", "--startup"},
+      [&](int argc, char* argv[]) {
+        // Every request has to be able to parse its arguments from scratch.
+        EXPECT_EQ(optind, 0);
+        optind = argc;
+
+        calls.emplace_back(argv, argv + argc);
+        EXPECT_EQ(argv[argc], nullptr);
+        LOG(ERROR) << "log of " << argv[argc - 1];
+        return calls.size() == 1 ? EXIT_SUCCESS : EXIT_FAILURE;
+      });
+  EXPECT_EQ(ret, EXIT_SUCCESS);
+
+  ASSERT_EQ(calls.size(), 2u);
+  EXPECT_EQ(calls[0], (std::vector<std::string>{"tool", "--startup", "--flag",
+                                                "first"}));
+  EXPECT_EQ(calls[1],
+            (std::vector<std::string>{"tool", "--startup", "second"}));
+
+  ASSERT_EQ(lseek(responses.fd, 0, SEEK_SET), 0);
+  google::protobuf::io::FileInputStream input(responses.fd);
+  sysprop::worker::WorkResponse response;
+  bool clean_eof = false;
+
+  ASSERT_TRUE(google::protobuf::util::ParseDelimitedFromZeroCopyStream(
+      &response, &input, &clean_eof));
+  EXPECT_EQ(response.exit_code(), EXIT_SUCCESS);
+  EXPECT_EQ(response.output(), "log of first\n");
+  EXPECT_EQ(response.request_id(), 1);
+
+  ASSERT_TRUE(google::protobuf::util::ParseDelimitedFromZeroCopyStream(
+      &response, &input, &clean_eof));
+  EXPECT_EQ(response.exit_code(), EXIT_FAILURE);
+  EXPECT_EQ(response.output(), "log of second\n");
+  EXPECT_EQ(response.request_id(), 2);
+
+  EXPECT_FALSE(google::protobuf::util::ParseDelimitedFromZeroCopyStream(
+      &response, &input, &clean_eof));
+  EXPECT_TRUE(clean_eof);
+}